@@ -0,0 +1,102 @@
+/*
+  Implementation for Atlas
+
+  The pieces are in the display format, so blitting from them is a straight
+copy, whatever the images were loaded as; the rotations come out of
+rotozoomSurface() as 32 bit RGBA, and are converted as they're copied on.
+Color keys and per-surface alpha are turned off for the copy, so the
+transparent black goes onto the page as black, and is keyed out again from
+there.  The pieces' SDL_Surfaces are made with SDL_CreateRGBSurfaceFrom(),
+so freeing one leaves its page alone, and a Surface that's already been
+packed is easy to spot.
+
+*/
+
+#include "atlas.h"
+#include <SDL/SDL_rotozoom.h>		// SDL_gfx Rotozoom
+
+namespace PatternSpace {
+
+/*********************  Atlas  *********************/
+    static const size_t CACHE_LINE = 64;
+
+    Atlas::Atlas(size_t pageBytes):
+        pageSize(pageBytes)
+    {
+        counts.pages = 0;
+        counts.pieces = 0;
+        counts.used = 0;
+        counts.bytes = 0;
+    }
+
+    Atlas::~Atlas()
+    {
+        for( size_t i = 0; i < pages.size(); i++ ) delete[] pages[i].pixels;
+    }
+
+    SDL_Surface* Atlas::place(SDL_Surface* image)
+    {
+        const SDL_PixelFormat* format = SDL_GetVideoSurface()->format;
+        int pitch = ( image->w * format->BytesPerPixel + 3 ) & ~3;
+        size_t bytes = size_t(pitch) * image->h;
+        if ( bytes > pageSize ) return 0;
+
+        size_t page = 0;
+        while ( page < pages.size() && pages[page].used + bytes > pageSize ) page++;
+        if ( page == pages.size() ) {
+            Page newPage;
+            newPage.pixels = new Uint8[pageSize + CACHE_LINE];
+            newPage.used = CACHE_LINE - size_t(newPage.pixels) % CACHE_LINE;
+            pages.push_back(newPage);
+            counts.pages = pages.size();
+            counts.bytes += pageSize;
+        }
+        Page& into = pages[page];
+        SDL_Surface* piece = SDL_CreateRGBSurfaceFrom( into.pixels + into.used, image->w, image->h,
+                                                       format->BitsPerPixel, pitch,
+                                                       format->Rmask, format->Gmask, format->Bmask, 0 );
+        into.used += ( bytes + CACHE_LINE - 1 ) / CACHE_LINE * CACHE_LINE;
+        counts.used += bytes;
+        counts.pieces++;
+
+        SDL_SetColorKey( image, 0, 0 );
+        SDL_SetAlpha( image, 0, SDL_ALPHA_OPAQUE );
+        SDL_BlitSurface( image, 0, piece, 0 );
+        Surface::keyBlack(piece);
+        return piece;
+    }
+
+    Atlas& Atlas::pack(const std::vector<Surface*>& surfaces, int steps)
+    {
+        for( size_t i = 0; i < surfaces.size(); i++ ) {
+            Surface& surface = *surfaces[i];
+            SDL_Surface* image = surface.current();
+            // our pieces are the only SDL_PREALLOC surfaces about.
+            if ( !image || ( image->flags & SDL_PREALLOC ) ) continue;
+
+            SDL_Surface* piece = place(image);
+            if ( piece ) SDL_FreeSurface( surface.replace(piece) );
+
+            if ( steps < 2 ) continue;
+            surface.rotations.assign( steps, static_cast<Surface*>(0) );
+            for( int step = 1; step < steps; step++ ) {
+                SDL_Surface* rotated = rotozoomSurface( surface.current(), -step * 360.0 / steps, 1, 1 );
+                piece = place(rotated);
+                SDL_FreeSurface(rotated);
+                if ( piece ) surface.rotations[step] = new Surface(piece);
+            }
+        }
+        return *this;
+    }
+
+    Atlas::Stats Atlas::stats() const
+    {
+        return counts;
+    }
+
+    double Atlas::occupancy() const
+    {
+        return counts.bytes ? double(counts.used) / counts.bytes : 0;
+    }
+
+} // end namespace PatternSpace
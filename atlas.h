@@ -0,0 +1,78 @@
+/*
+  Atlas
+
+  Every image starts out in its own small SDL_Surface, and so does every
+rotation the RotationCache makes of it, each allocated on its own whenever
+it's first drawn, so a busy frame jumps between hundreds of little surfaces
+scattered all over memory.  An Atlas copies images onto a few big pages
+instead, with every rotation of each one, at every step, made ahead of time
+and laid out right after it, so drawing takes the rotations straight from
+the Surface (see Surface::rotations) without going through the cache.
+
+  A page here is a block of memory, not one big 2D surface: each piece gets
+an SDL_Surface of its own over its part of the page, with rows no wider than
+itself.  The usual texture atlas, with pieces packed side by side in shelves,
+makes every row of a piece a whole page's pitch from the next, which a
+software blitter pays for on every row, and SDL's RLE blitter has to walk
+every row above a piece to find it.  Laid out this way, each piece is one
+run of memory, and when SDL does the blitting (see Surface::keyBlack()),
+can be RLE encoded on its own.
+
+  Pieces are placed first fit: in the first page with room left at the end,
+or a new one, each starting on a cache line.
+
+Usage:
+  pack() the Surfaces with the number of RotationCache::steps() to make
+rotations for (none, if it's zero), while nothing is drawing them: at the
+end of loading, say.  Pieces too big for a page are left as they were.  The
+Atlas must outlive the Surfaces packed into it.
+
+*/
+#ifndef PATTERN_SPACE_ATLAS_INCLUSION_GUARD
+#define PATTERN_SPACE_ATLAS_INCLUSION_GUARD
+
+#include <vector>
+
+#include "image.h"
+
+namespace PatternSpace {
+
+/*********************  Atlas  *********************/
+    class Atlas {
+    public:
+        struct Stats {
+            size_t pages;
+            unsigned long pieces;       // images and rotations packed
+            size_t used;                // bytes of the pages
+            size_t bytes;
+        };
+
+        explicit Atlas(size_t pageBytes = 4 << 20);
+        ~Atlas();
+
+        Atlas& pack(const std::vector<Surface*>& surfaces, int steps);
+
+        Stats stats() const;
+        // of the pages' bytes, the fraction used.
+        double occupancy() const;
+
+    private:
+        struct Page {
+            Uint8* pixels;
+            size_t used;
+        };
+
+        // a copy of image on a page, in the display format, or 0 if it's
+        // too big.
+        SDL_Surface* place(SDL_Surface* image);
+
+        size_t pageSize;
+        std::vector<Page> pages;
+        Stats counts;
+
+        Atlas(const Atlas&);
+        Atlas& operator=(const Atlas&);
+    }; // end class Atlas
+
+} // end namespace PatternSpace
+#endif  // PATTERN_SPACE_ATLAS_INCLUSION_GUARD
@@ -0,0 +1,851 @@
+/*
+    bench_universe
+
+  Runs the Universe without a window, as fast as it will go, and reports how
+long it took as JSON, so it can be run on a build server and compared from
+one build (or machine) to the next.  It spawns rocks, aliens and missiles
+through the factories, scattered over a square that grows with their number
+so the density stays about the same, steps the Universe a fixed number of
+times, and optionally draws each step into the HEADLESS Screen as well.
+
+  The images are loaded from images/, so run it from the top of the tree.
+
+Options:
+  --rocks N --aliens N --missiles N   how many of each to start with
+  --steps M                           how many steps to time
+  --step-ms T                         the length of a step
+  --seed S                            for the starting positions
+  --threads N                         as in the game
+  --collisions brute|grid
+  --gravity pairwise|barnes-hut|barnes-hut-checked
+  --theta T                           see Universe::openingAngle()
+  --active-radius R                   see Universe::activeRegion()
+  --scalar                            don't use the AVX2 kernels
+  --check-kernels                     run the kernel check below instead
+  --draw                              also drawAll() after every step
+  --cull-margin M                     see Universe::cullMargin()
+  --dirty-rects                       draw on a DIRTY_RECTS Screen
+  --parallax D                        add a second star field at depth D
+                                      to the Background
+  --rotation-steps N                  see RotationCache::steps()
+  --rotation-budget MB                see RotationCache::budget()
+  --background-images                 load the images in the background,
+                                      warming images/manifest.txt first
+  --atlas                             pack the images into an Atlas, once
+                                      they're loaded
+  --render N                          run the render benchmark below
+                                      instead, with N sprites
+  --frames F                          how many frames it draws
+  --blits N                           run the blit benchmark below
+                                      instead, with N sprites
+  --paint-threads N                   draw in bands on N threads; see
+                                      Screen::threads()
+  --swept                             see Universe::sweptCollisions()
+  --contact-iterations N              see Universe::contactIterations()
+  --cluster                           pack the rocks together, at rest
+  --replay FILE                       run a Journal (see journal.h) instead
+  --pool-limit N                      high-water mark of the SolidPools
+  --firefight N                       run the firefight below instead, with
+                                      N missiles
+  --missile-speed S                   the fastest missile in the firefight
+
+Output:
+  One JSON object.  ns_per_solid_step divides the total time by the sum over
+the steps of the number of Solids in each, since the number changes as
+things collide, die and explode.  phases_ns breaks the time down into the
+phases of Universe::Phase.  The first step, which only brings the Solids
+into the Universe, isn't counted.  A replay takes its scene, step length and
+number of steps from the Journal, and also reports the final digest and
+whether it matches the recorded one.  pools gives the SolidPools' counts,
+including the warm-up step.  contacts gives the ContactSolver's counts per
+step, and rock_speed the average speed of the rocks still there at the end,
+which shows how well a --cluster has settled.  rotations gives the
+RotationCache's counts, when drawing, culling the Solids drawAll() drew
+and culled per frame, screen how much of it was presented per frame,
+background how often the Background's cache was composed, and images the
+ImageStore's, over the whole run.  With barnes-hut-checked, gravity_error
+gives the relative error of the Barnes-Hut forces over the timed steps
+(see Universe::gravityError()): the mean over every body of every step,
+the worst, and how many bodies were checked in each step, on average.
+
+  The firefight measures how far the step rate can drop before missiles
+start passing through rocks.  It's a Journal of N rocks in a column, each
+with a missile aimed at it from 300 pixels away, at speeds between half of
+S and S.  The same Journal is replayed at a range of step rates, once with
+the collisions as they are at the start of each step, and once swept, for
+long enough for every missile to get there.  A missile that's still alive
+at the end has been missed.  The reference is the swept replay at the
+original 150 steps a second; missed counts the missiles that hit in the
+reference and not at that rate, and lowest_hz is the lowest rate at which
+none have been missed, at that rate or any above it.
+
+  The kernel check runs every kernel of kernels.h on both paths, on the
+same random bodies and candidate pairs, and reports the largest difference
+between them: the gravity totals relative to the largest force, and the
+contacts field by field.  It exits with 1 if the paths found different
+contacts, or any difference is over KERNEL_TOLERANCE.  On a machine without
+AVX2 both runs take the scalar path, and it only checks that much.
+
+  The render benchmark only draws: N sprites, made from every image the
+factories use, scattered over the screen, each turning at its own rate,
+for F frames, clearing the screen before each.  The first frame, which makes
+the rotations, isn't counted.  It reports the time per sprite drawn, and
+with --atlas, how many pages the Atlas took and how full they are.  With
+--paint-threads, it also draws one more frame both ways, in bands and one
+blit after another, and reports whether they came out pixel for pixel the
+same, and how many frames the Raster drew in bands and how many it had to
+draw serially with SDL instead.  It exits with 1 if the two frames differ,
+or any frame was drawn serially, since then the bands weren't tested.
+
+  The blit benchmark draws N sprites, unrotated, at the same scattered
+places every frame, some of them hanging off the edges, along each
+blitPath() in turn: SDL_BlitSurface first, with the images RLE encoded, and
+then keyedCopy() with each instruction set the CPU has, with them decoded
+again (see ImageStore::rekey()).  It reports how many megapixels a second
+each path blitted, counting the pixels on the screen only and leaving out
+the clear, and whether its last frame came out the same as SDL's.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "vector2d.h"
+#include "universe.h"
+#include "factories.h"
+#include "kernels.h"
+#include "journal.h"
+#include "clock.h"
+#include "imagestore.h"
+#include "raster.h"
+
+using namespace PatternSpace;
+
+// somewhere in a square of the given side, centered on the origin.
+static Vector2d scatter(int side)
+{
+    return Vector2d( rand() % side - side / 2, rand() % side - side / 2 );
+}
+
+// a random velocity of at most speed in each direction.
+static Vector2d drift(double speed)
+{
+    return Vector2d( speed * (rand() % 201 - 100) / 100, speed * (rand() % 201 - 100) / 100 );
+}
+
+// the ship's Controls, or ones that do nothing once it's gone.
+static Controls& controlsOf(Universe& universe, SolidHandle ship)
+{
+    static NoControls none;
+    Ship* pShip = dynamic_cast<Ship*>( universe.find(ship) );
+    return pShip ? static_cast<Controls&>(*pShip) : none;
+}
+
+// the settings a firefight's Universes share with the benchmark.
+struct Settings {
+    int threads;
+    Universe::CollisionMode collisions;
+    Universe::GravityMode gravity;
+    double theta;               // unless it's negative
+};
+
+// replay the firefight for duration milliseconds, and mark which missiles
+// hit something.
+static double fight( const Journal& journal, double duration, double hz, bool swept, const Settings& settings,
+                     Screen& screen, Background& background, std::vector<bool>& hit )
+{
+    Universe universe( &screen, &background );
+    standardInteractions(universe);
+    universe.threads(settings.threads)
+        .collisionMode(settings.collisions)
+        .gravityMode(settings.gravity)
+        .sweptCollisions(swept)
+        .painter(false);
+    if ( settings.theta >= 0 ) universe.openingAngle(settings.theta);
+    universe.center( Vector2d(0,0) );
+    std::vector<SolidHandle> handles;
+    journal.populate( universe, &handles );
+
+    double stepLength = 1000.0 / hz;
+    int steps = int( ceil( duration / stepLength ) ) + 1;
+    unsigned long long start = nanoseconds();
+    for( int step = 0; step < steps; step++ ) {
+        universe.simulateAll(stepLength);
+    }
+    double seconds = ( nanoseconds() - start ) / 1e9;
+
+    // the missiles are every other Solid, after their rocks.
+    hit.assign( handles.size() / 2, false );
+    for( size_t i = 0; i < hit.size(); i++ ) {
+        hit[i] = universe.find( handles[2*i + 1] ) == 0;
+    }
+    return seconds;
+}
+
+static int firefight( int missiles, double speed, const Settings& settings,
+                      Screen& screen, Background& background )
+{
+    // a missile lives for 500 reference steps; see makeMissle().
+    double flight = 300 / ( speed / 2 ) + 20;
+    if ( speed <= 0 || flight >= 500 ) {
+        fprintf( stderr, "bench_universe: missiles that slow wouldn't get there\n" );
+        return 1;
+    }
+    // long enough for the slowest missile to cover 300 pixels, and then some.
+    double duration = flight * REFERENCE_STEP;
+    Journal journal;
+    for( int i = 0; i < missiles; i++ ) {
+        double y = 120 * i;
+        journal.place( "rock", Vector2d( 0, y ), Vector2d() );
+        journal.place( "missle", Vector2d( -300, y + rand() % 11 - 5 ), Vector2d( speed * ( 50 + rand() % 51 ) / 100, 0 ) );
+    }
+
+    static const double rates[] = { 150, 120, 100, 75, 60, 50, 40, 30, 25, 20, 15, 10 };
+    const int RATES = sizeof(rates) / sizeof(rates[0]);
+    std::vector<bool> reference, hit;
+    fight( journal, duration, 150, true, settings, screen, background, reference );
+    int referenceHits = 0;
+    for( size_t i = 0; i < reference.size(); i++ ) referenceHits += reference[i];
+
+    printf( "{\n" );
+    printf( "  \"firefight\": %d,\n", missiles );
+    printf( "  \"missile_speed\": %g,\n", speed );
+    printf( "  \"collisions\": \"%s\",\n", settings.collisions == Universe::UNIFORM_GRID ? "grid" : "brute" );
+    printf( "  \"reference_hits\": %d,\n", referenceHits );
+    printf( "  \"rates\": [" );
+    double lowest[2] = { 0, 0 };
+    bool clean[2] = { true, true };
+    for( int rate = 0; rate < RATES; rate++ ) {
+        int hits[2], missed[2];
+        double seconds[2];
+        for( int swept = 0; swept < 2; swept++ ) {
+            seconds[swept] = fight( journal, duration, rates[rate], swept, settings, screen, background, hit );
+            hits[swept] = missed[swept] = 0;
+            for( size_t i = 0; i < hit.size(); i++ ) {
+                hits[swept] += hit[i];
+                missed[swept] += reference[i] && !hit[i];
+            }
+            clean[swept] = clean[swept] && missed[swept] == 0;
+            if ( clean[swept] ) lowest[swept] = rates[rate];
+        }
+        printf( "%s{ \"hz\": %g, \"hits\": %d, \"missed\": %d, \"seconds\": %.6f, "
+                "\"swept_hits\": %d, \"swept_missed\": %d, \"swept_seconds\": %.6f }",
+                rate ? ",\n             " : " ", rates[rate], hits[0], missed[0], seconds[0],
+                hits[1], missed[1], seconds[1] );
+    }
+    printf( " ],\n" );
+    printf( "  \"lowest_hz\": %g,\n", lowest[0] );
+    printf( "  \"lowest_swept_hz\": %g\n", lowest[1] );
+    printf( "}\n" );
+    return 0;
+}
+
+// how far apart the two paths of the kernels may be; see checkKernels().
+static const double KERNEL_TOLERANCE = 1e-9;
+
+// a random number between low and high.
+static double between(double low, double high)
+{
+    return low + ( high - low ) * rand() / RAND_MAX;
+}
+
+// the kernels' inputs: bodies, in two sets for crossGravity(), and the
+// candidate pairs for collisionContacts().
+struct KernelInputs {
+    std::vector<double> x, y, vx, vy, mass, radius;
+    std::vector< std::pair<int,int> > candidates;
+    int first;      // bodies in the first set
+};
+
+// what one path made of them.
+struct KernelOutputs {
+    std::vector<double> fx, fy;             // pairwiseGravity()
+    std::vector<double> crossX, crossY;     // crossGravity()
+    std::vector<Contact> contacts, swept;   // collisionContacts()
+};
+
+static KernelOutputs runKernels( const KernelInputs& in, KernelPath path )
+{
+    kernelPath(path);
+    KernelOutputs out;
+    int n = int( in.x.size() ), second = n - in.first;
+    out.fx.assign( n, 0 );
+    out.fy.assign( n, 0 );
+    pairwiseGravity( n, &in.x[0], &in.y[0], &in.mass[0], &in.radius[0], &out.fx[0], &out.fy[0] );
+    out.crossX.assign( n, 0 );
+    out.crossY.assign( n, 0 );
+    crossGravity( in.first, &in.x[0], &in.y[0], &in.mass[0], &in.radius[0],
+                  second, &in.x[in.first], &in.y[in.first], &in.mass[in.first], &in.radius[in.first],
+                  &out.crossX[0], &out.crossY[0], &out.crossX[in.first], &out.crossY[in.first] );
+    int count = int( in.candidates.size() );
+    out.contacts.resize(count);
+    out.contacts.resize( collisionContacts( count, &in.candidates[0], &in.x[0], &in.y[0], &in.vx[0], &in.vy[0],
+                                            &in.mass[0], &in.radius[0], 0, &out.contacts[0] ) );
+    out.swept.resize(count);
+    out.swept.resize( collisionContacts( count, &in.candidates[0], &in.x[0], &in.y[0], &in.vx[0], &in.vy[0],
+                                         &in.mass[0], &in.radius[0], 20, &out.swept[0] ) );
+    return out;
+}
+
+// the largest difference between two sets of forces, relative to the
+// largest force.
+static double forceError( const std::vector<double>& x1, const std::vector<double>& y1,
+                          const std::vector<double>& x2, const std::vector<double>& y2 )
+{
+    double largest = 0, error = 0;
+    for( size_t i = 0; i < x1.size(); i++ ) {
+        largest = std::max( largest, std::max( fabs( x1[i] ), fabs( y1[i] ) ) );
+        error = std::max( error, std::max( fabs( x1[i] - x2[i] ), fabs( y1[i] - y2[i] ) ) );
+    }
+    return largest > 0 ? error / largest : error;
+}
+
+// the largest difference between two lists of contacts, or -1 if they
+// aren't for the same pairs.
+static double contactError( const std::vector<Contact>& c1, const std::vector<Contact>& c2 )
+{
+    if ( c1.size() != c2.size() ) return -1;
+    double error = 0;
+    for( size_t i = 0; i < c1.size(); i++ ) {
+        if ( c1[i].pair != c2[i].pair ) return -1;
+        double fields[5] = { c1[i].axisX - c2[i].axisX, c1[i].axisY - c2[i].axisY, c1[i].overlap - c2[i].overlap,
+                             c1[i].impulse - c2[i].impulse, c1[i].impact - c2[i].impact };
+        for( int field = 0; field < 5; field++ ) error = std::max( error, fabs( fields[field] ) );
+    }
+    return error;
+}
+
+// run the kernels both ways on the same bodies, and compare.
+static int checkKernels( int bodies )
+{
+    KernelInputs in;
+    int side = int( 40 * sqrt( double(bodies) ) ) + 1;
+    for( int i = 0; i < bodies; i++ ) {
+        Vector2d place = scatter(side);
+        in.x.push_back( place.x() );
+        in.y.push_back( place.y() );
+        in.vx.push_back( between( -5, 5 ) );
+        in.vy.push_back( between( -5, 5 ) );
+        in.mass.push_back( between( 1, 1000 ) );
+        in.radius.push_back( between( 2, 30 ) );
+    }
+    in.first = bodies / 3;
+    for( int i = 0; i < bodies; i++ ) {
+        for( int j = i + 1; j < bodies; j++ ) {
+            double dx = in.x[j] - in.x[i], dy = in.y[j] - in.y[i];
+            double reach = in.radius[i] + in.radius[j] + 40;
+            if ( dx * dx + dy * dy < reach * reach ) in.candidates.push_back( std::make_pair( i, j ) );
+        }
+    }
+    if ( in.candidates.empty() ) in.candidates.push_back( std::make_pair( 0, bodies - 1 ) );
+
+    KernelPath best = kernelPath(AVX2_KERNELS);
+    KernelOutputs scalar = runKernels( in, SCALAR_KERNELS );
+    KernelOutputs fast = runKernels( in, best );
+    kernelPath(best);
+
+    double pairwise = forceError( scalar.fx, scalar.fy, fast.fx, fast.fy );
+    double cross = forceError( scalar.crossX, scalar.crossY, fast.crossX, fast.crossY );
+    double contacts = contactError( scalar.contacts, fast.contacts );
+    double swept = contactError( scalar.swept, fast.swept );
+    bool agree = pairwise <= KERNEL_TOLERANCE && cross <= KERNEL_TOLERANCE
+              && contacts >= 0 && contacts <= KERNEL_TOLERANCE && swept >= 0 && swept <= KERNEL_TOLERANCE;
+
+    printf( "{\n" );
+    printf( "  \"bodies\": %d,\n", bodies );
+    printf( "  \"candidates\": %d,\n", int( in.candidates.size() ) );
+    printf( "  \"path\": \"%s\",\n", best == AVX2_KERNELS ? "avx2" : "scalar" );
+    printf( "  \"tolerance\": %g,\n", KERNEL_TOLERANCE );
+    printf( "  \"pairwise_gravity\": %g,\n", pairwise );
+    printf( "  \"cross_gravity\": %g,\n", cross );
+    printf( "  \"contacts\": { \"found\": %d, \"error\": %g },\n", int( scalar.contacts.size() ), contacts );
+    printf( "  \"swept_contacts\": { \"found\": %d, \"error\": %g },\n", int( scalar.swept.size() ), swept );
+    printf( "  \"agree\": %s\n", agree ? "true" : "false" );
+    printf( "}\n" );
+    return agree ? 0 : 1;
+}
+
+static void drawFrame( std::vector<SpriteState>& states, Screen& screen )
+{
+    screen.clear();
+    for( size_t i = 0; i < states.size(); i++ ) states[i].draw(screen);
+    screen.flip();
+}
+
+// the visible bits of every pixel on the screen.
+static std::vector<Uint32> pixels( Screen& screen )
+{
+    SDL_Surface* surface = screen.surface;
+    const SDL_PixelFormat* format = surface->format;
+    Uint32 mask = format->Rmask | format->Gmask | format->Bmask | format->Amask;
+    std::vector<Uint32> copy;
+    for( int y = 0; y < surface->h; y++ ) {
+        const Uint32* row = reinterpret_cast<const Uint32*>( static_cast<const Uint8*>(surface->pixels) + y * surface->pitch );
+        for( int x = 0; x < surface->w; x++ ) copy.push_back( row[x] & mask );
+    }
+    return copy;
+}
+
+// blit sprites at the same places, frames times, along every blitPath().
+static int blits( int sprites, int frames, Screen& screen )
+{
+    static const char* files[] = {
+        "images/rock.bmp", "images/big-rock.bmp", "images/alien1-1.bmp", "images/explode4.bmp",
+        "images/ship.bmp", "images/missle1.bmp", "images/big-ship.bmp" };
+    const int FILES = sizeof(files) / sizeof(files[0]);
+    std::vector< boost::shared_ptr<Image> > images;
+    std::vector<Vector2d> places;
+    Vector2d size = screen.size();
+    unsigned long long pixelsPerFrame = 0;
+    for( int i = 0; i < sprites; i++ ) {
+        const char* file = files[ i % FILES ];
+        images.push_back( ImageStore::image(file) );
+        Vector2d place( rand() % ( int( size.x() ) + 64 ) - 32, rand() % ( int( size.y() ) + 64 ) - 32 );
+        places.push_back(place);
+        Vector2d extent = ImageStore::bitmap(file).size();
+        Vector2d corner = place - extent / 2;
+        int left = std::max( int( corner.x() ), 0 ), top = std::max( int( corner.y() ), 0 );
+        int right = std::min( int( corner.x() ) + int( extent.x() ), int( size.x() ) );
+        int bottom = std::min( int( corner.y() ) + int( extent.y() ), int( size.y() ) );
+        if ( right > left && bottom > top ) pixelsPerFrame += ( right - left ) * ( bottom - top );
+    }
+
+    static const char* names[] = { "sdl", "scalar", "sse2", "avx2" };
+    BlitPath best = blitPath();
+    std::vector<Uint32> reference;
+    printf( "{\n" );
+    printf( "  \"blits\": %d,\n", sprites );
+    printf( "  \"frames\": %d,\n", frames );
+    printf( "  \"pixels_per_frame\": %llu,\n", pixelsPerFrame );
+    printf( "  \"paths\": [" );
+    for( int path = SDL_BLITS; path <= best; path++ ) {
+        blitPath( BlitPath(path) );
+        ImageStore::rekey();
+        unsigned long long elapsed = 0;
+        for( int frame = 0; frame <= frames; frame++ ) {
+            screen.clear();
+            unsigned long long start = nanoseconds();
+            for( int i = 0; i < sprites; i++ ) images[i]->draw( screen, places[i], 0 );
+            if ( frame > 0 ) elapsed += nanoseconds() - start;
+        }
+        bool identical = true;
+        if ( path == SDL_BLITS ) {
+            reference = pixels(screen);
+        } else {
+            identical = pixels(screen) == reference;
+        }
+        double seconds = elapsed / 1e9;
+        printf( "%s{ \"path\": \"%s\", \"seconds\": %.6f, \"megapixels_per_second\": %.1f, \"identical\": %s }",
+                path ? ",\n             " : " ", names[path], seconds,
+                seconds > 0 ? pixelsPerFrame * frames / seconds / 1e6 : 0.0, identical ? "true" : "false" );
+    }
+    printf( " ]\n}\n" );
+    blitPath(best);
+    ImageStore::rekey();
+    return 0;
+}
+
+// draw sprites all over the screen, frames times.
+static int render( int sprites, int frames, bool atlas, Screen& screen )
+{
+    static const char* files[] = {
+        "images/rock.bmp", "images/big-rock.bmp", "images/alien1-1.bmp", "images/alien1-2.bmp",
+        "images/alien1-3.bmp", "images/explode1.bmp", "images/explode2.bmp", "images/explode3.bmp",
+        "images/explode4.bmp", "images/explode5.bmp", "images/explode6.bmp", "images/explode7.bmp",
+        "images/ship.bmp", "images/missle1.bmp" };
+    const int FILES = sizeof(files) / sizeof(files[0]);
+    std::vector< boost::shared_ptr<Image> > images;
+    std::vector<SpriteState> states( sprites );
+    std::vector<double> spins( sprites );
+    Vector2d size = screen.size();
+    for( int i = 0; i < sprites; i++ ) {
+        images.push_back( ImageStore::image( files[ i % FILES ] ) );
+        states[i].image = images.back().get();
+        states[i].position = states[i].lastPosition = Vector2d( rand() % int( size.x() ), rand() % int( size.y() ) );
+        states[i].angle = states[i].lastAngle = rand() % 360;
+        states[i].radius = 0;
+        spins[i] = ( rand() % 201 - 100 ) / 20.0;
+    }
+    if ( atlas ) {
+        ImageStore::background(false);
+        ImageStore::pack();
+    }
+
+    unsigned long long start = 0;
+    for( int frame = 0; frame <= frames; frame++ ) {
+        if ( frame == 1 ) start = nanoseconds();
+        drawFrame( states, screen );
+        for( int i = 0; i < sprites; i++ ) {
+            states[i].angle = states[i].lastAngle = states[i].angle + spins[i];
+        }
+    }
+    unsigned long long elapsed = nanoseconds() - start;
+
+    int threads = screen.threads();
+    bool identical = true;
+    unsigned long bandedFrames = 0, serialFrames = 0;
+    if ( threads > 1 ) {
+        // changing the threads makes a new Raster, so count this one's now.
+        Raster::Stats timed = screen.raster()->stats();
+        screen.threads(1);
+        drawFrame( states, screen );
+        std::vector<Uint32> serial = pixels(screen);
+        screen.threads(threads);
+        drawFrame( states, screen );
+        identical = pixels(screen) == serial;
+        const Raster::Stats& compared = screen.raster()->stats();
+        serialFrames = timed.serial + compared.serial;
+        bandedFrames = timed.frames + compared.frames - serialFrames;
+    }
+    double seconds = elapsed / 1e9;
+    unsigned long long drawn = (unsigned long long)sprites * frames;
+
+    printf( "{\n" );
+    printf( "  \"render\": %d,\n", sprites );
+    printf( "  \"frames\": %d,\n", frames );
+    printf( "  \"atlas\": %s,\n", atlas ? "true" : "false" );
+    printf( "  \"rotation_steps\": %d,\n", RotationCache::steps() );
+    printf( "  \"paint_threads\": %d,\n", threads );
+    if ( threads > 1 ) {
+        printf( "  \"bands_identical\": %s,\n", identical ? "true" : "false" );
+        printf( "  \"banded_frames\": %lu,\n", bandedFrames );
+        printf( "  \"serial_frames\": %lu,\n", serialFrames );
+    }
+    printf( "  \"seconds\": %.6f,\n", seconds );
+    printf( "  \"ns_per_sprite\": %.3f,\n", drawn ? double(elapsed) / drawn : 0.0 );
+    printf( "  \"sprites_per_second\": %.0f", seconds > 0 ? drawn / seconds : 0.0 );
+    if ( atlas ) {
+        Atlas::Stats packed = ImageStore::atlas().stats();
+        printf( ",\n  \"atlas_pages\": %lu,\n", (unsigned long)packed.pages );
+        printf( "  \"atlas_pieces\": %lu,\n", packed.pieces );
+        printf( "  \"atlas_bytes\": %lu,\n", (unsigned long)packed.bytes );
+        printf( "  \"atlas_occupancy\": %.4f", ImageStore::atlas().occupancy() );
+    }
+    printf( "\n}\n" );
+    return ( identical && serialFrames == 0 ) ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+
+    int rocks = 400, aliens = 50, missiles = 50;
+    int steps = 600;
+    double stepLength = 1000.0 / 60;
+    unsigned seed = 1;
+    int threads = 1;
+    double activeRadius = 0;
+    bool draw = false;
+    bool checking = false;
+    double cullMargin = 64;
+    Screen::Presentation presentation = Screen::FLIP;
+    double parallax = 0;
+    int paintThreads = 1;
+    bool swept = false;
+    int contactIterations = 0;
+    bool cluster = false;
+    bool backgroundImages = false;
+    bool atlas = false;
+    int renderSprites = 0;
+    int blitSprites = 0;
+    int frames = 100;
+    int firefightMissiles = 0;
+    double missileSpeed = 16;
+    const char* replayFile = 0;
+    Universe::CollisionMode collisions = Universe::BRUTE_FORCE;
+    Universe::GravityMode gravity = Universe::PAIRWISE;
+    double theta = -1;
+
+    for( int arg = 1; arg < argc; arg++ ) {
+        bool more = arg + 1 < argc;
+        if ( strcmp( argv[arg], "--rocks" ) == 0 && more ) {
+            rocks = atoi( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--aliens" ) == 0 && more ) {
+            aliens = atoi( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--missiles" ) == 0 && more ) {
+            missiles = atoi( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--steps" ) == 0 && more ) {
+            steps = atoi( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--step-ms" ) == 0 && more ) {
+            stepLength = atof( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--seed" ) == 0 && more ) {
+            seed = atoi( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--threads" ) == 0 && more ) {
+            threads = atoi( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--collisions" ) == 0 && more ) {
+            arg++;
+            collisions = strcmp( argv[arg], "grid" ) == 0 ? Universe::UNIFORM_GRID : Universe::BRUTE_FORCE;
+        } else if ( strcmp( argv[arg], "--gravity" ) == 0 && more ) {
+            arg++;
+            if ( strcmp( argv[arg], "barnes-hut" ) == 0 ) {
+                gravity = Universe::BARNES_HUT;
+            } else if ( strcmp( argv[arg], "barnes-hut-checked" ) == 0 ) {
+                gravity = Universe::BARNES_HUT_CHECKED;
+            } else {
+                gravity = Universe::PAIRWISE;
+            }
+        } else if ( strcmp( argv[arg], "--theta" ) == 0 && more ) {
+            theta = atof( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--active-radius" ) == 0 && more ) {
+            activeRadius = atof( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--scalar" ) == 0 ) {
+            kernelPath(SCALAR_KERNELS);
+        } else if ( strcmp( argv[arg], "--check-kernels" ) == 0 ) {
+            checking = true;
+        } else if ( strcmp( argv[arg], "--draw" ) == 0 ) {
+            draw = true;
+        } else if ( strcmp( argv[arg], "--cull-margin" ) == 0 && more ) {
+            cullMargin = atof( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--dirty-rects" ) == 0 ) {
+            presentation = Screen::DIRTY_RECTS;
+        } else if ( strcmp( argv[arg], "--paint-threads" ) == 0 && more ) {
+            paintThreads = atoi( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--parallax" ) == 0 && more ) {
+            parallax = atof( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--rotation-steps" ) == 0 && more ) {
+            RotationCache::steps( atoi( argv[++arg] ) );
+        } else if ( strcmp( argv[arg], "--rotation-budget" ) == 0 && more ) {
+            RotationCache::budget( size_t( atof( argv[++arg] ) * ( 1 << 20 ) ) );
+        } else if ( strcmp( argv[arg], "--atlas" ) == 0 ) {
+            atlas = true;
+        } else if ( strcmp( argv[arg], "--render" ) == 0 && more ) {
+            renderSprites = atoi( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--blits" ) == 0 && more ) {
+            blitSprites = atoi( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--frames" ) == 0 && more ) {
+            frames = atoi( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--background-images" ) == 0 ) {
+            backgroundImages = true;
+        } else if ( strcmp( argv[arg], "--swept" ) == 0 ) {
+            swept = true;
+        } else if ( strcmp( argv[arg], "--contact-iterations" ) == 0 && more ) {
+            contactIterations = atoi( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--cluster" ) == 0 ) {
+            cluster = true;
+        } else if ( strcmp( argv[arg], "--replay" ) == 0 && more ) {
+            replayFile = argv[++arg];
+        } else if ( strcmp( argv[arg], "--firefight" ) == 0 && more ) {
+            firefightMissiles = atoi( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--missile-speed" ) == 0 && more ) {
+            missileSpeed = atof( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--pool-limit" ) == 0 && more ) {
+            size_t limit = atoi( argv[++arg] );
+            misslePool().highWater(limit);
+            explosionPool().highWater(limit);
+        } else {
+            fprintf( stderr, "bench_universe: unknown option %s\n", argv[arg] );
+            return 1;
+        }
+    }
+
+    if ( checking ) {
+        srand(seed);
+        return checkKernels( rocks + aliens + missiles );
+    }
+
+    Screen screen(Screen::HEADLESS, presentation);
+    screen.origin(Vector2d(0,0));
+    screen.threads(paintThreads);
+    Background background("images/stars.bmp");
+    if ( parallax > 0 ) background.layer( BitmapImage("images/stars.bmp"), parallax );
+    if ( backgroundImages ) {
+        ImageStore::background(true);
+        ImageStore::warm("images/manifest.txt");
+    }
+
+    if ( blitSprites > 0 ) {
+        srand(seed);
+        return blits( blitSprites, frames, screen );
+    }
+    if ( renderSprites > 0 ) {
+        srand(seed);
+        int result = render( renderSprites, frames, atlas, screen );
+        ImageStore::background(false);
+        return result;
+    }
+
+    if ( firefightMissiles > 0 ) {
+        srand(seed);
+        Settings settings = { threads, collisions, gravity, theta };
+        int result = firefight( firefightMissiles, missileSpeed, settings, screen, background );
+        ImageStore::background(false);
+        return result;
+    }
+
+    Universe universe( &screen, &background );
+    standardInteractions(universe);
+    universe.threads(threads)
+        .collisionMode(collisions)
+        .gravityMode(gravity)
+        .activeRegion(activeRadius, 4)
+        .sweptCollisions(swept)
+        .contactIterations(contactIterations)
+        .cullMargin(cullMargin)
+        .painter(draw);
+    if ( theta >= 0 ) universe.openingAngle(theta);
+    universe.center( Vector2d(0,0) );
+
+    Journal journal;
+    SolidHandle ship;
+    std::vector<SolidHandle> handles;
+    int solids = rocks + aliens + missiles;
+    if ( replayFile ) {
+        if ( !journal.read(replayFile) || journal.steps < 1 ) {
+            fprintf( stderr, "bench_universe: unable to read journal %s\n", replayFile );
+            ImageStore::background(false);
+            return 1;
+        }
+        ship = journal.populate(universe);
+        universe.follow(ship);
+        solids = journal.placed();
+        stepLength = journal.stepLength;
+        steps = int(journal.steps) - 1;
+    } else {
+        srand(seed);
+        int side = int( sqrt( double(solids) ) * 75 ) + 1;
+        std::vector< boost::shared_ptr<Solid> > scene;
+        scene.reserve(solids);
+        // a cluster is a hexagonal lattice of rocks, each just touching
+        // its neighbors.
+        int across = int( ceil( sqrt( double(rocks) ) ) );
+        for( int i = 0; i < rocks; i++ ) {
+            if ( cluster ) {
+                int row = i / across, column = i % across;
+                Vector2d place( 40 * ( column - across / 2 ) + 20 * ( row % 2 ), 40 * .8660254 * ( row - across / 2 ) );
+                scene.push_back( newRock( place, Vector2d() ) );
+            } else {
+                scene.push_back( newRock( scatter(side), drift(.3) ) );
+            }
+        }
+        for( int i = 0; i < aliens; i++ ) {
+            scene.push_back( newAlien( scatter(side), drift(.3) ) );
+        }
+        for( int i = 0; i < missiles; i++ ) {
+            scene.push_back( newMissle( scatter(side), drift(1) ) );
+        }
+        universe.add( scene, &handles );
+    }
+    if ( atlas ) {
+        ImageStore::background(false);
+        ImageStore::pack();
+    }
+
+    // bring everyone in, then start counting.
+    if ( replayFile ) journal.replay( 0, controlsOf(universe, ship) );
+    universe.simulateAll(stepLength);
+    unsigned long long before[Universe::PHASES];
+    for( int phase = 0; phase < Universe::PHASES; phase++ ) {
+        before[phase] = universe.phaseTime( Universe::Phase(phase) );
+    }
+
+    unsigned long long solidSteps = 0;
+    double errorSum = 0, errorWorst = 0;
+    unsigned long long errorBodies = 0;
+    unsigned long long start = nanoseconds();
+    for( int step = 0; step < steps; step++ ) {
+        if ( replayFile ) journal.replay( step + 1, controlsOf(universe, ship) );
+        universe.simulateAll(stepLength);
+        const Universe::Tiers& tiers = universe.tiers();
+        solidSteps += tiers.active + tiers.dormant;
+        const Universe::GravityError& error = universe.gravityError();
+        errorSum += error.mean * error.bodies;
+        errorBodies += error.bodies;
+        errorWorst = std::max( errorWorst, error.worst );
+        if ( draw ) universe.drawAll();
+    }
+    unsigned long long elapsed = nanoseconds() - start;
+    ImageStore::background(false);
+
+    double rockSpeed = 0;
+    int rocksLeft = 0;
+    for( int i = 0; i < rocks && i < int(handles.size()); i++ ) {
+        Solid* pRock = universe.find( handles[i] );
+        if ( pRock ) {
+            rockSpeed += pRock->velocity().magnitude();
+            rocksLeft++;
+        }
+    }
+    if ( rocksLeft ) rockSpeed /= rocksLeft;
+
+    static const char* phaseNames[Universe::PHASES] = { "interact", "normalize", "step", "publish", "draw" };
+    double seconds = elapsed / 1e9;
+    printf( "{\n" );
+    printf( "  \"solids\": %d,\n", solids );
+    printf( "  \"steps\": %d,\n", steps );
+    printf( "  \"step_ms\": %.4f,\n", stepLength );
+    printf( "  \"threads\": %d,\n", universe.threads() );
+    printf( "  \"collisions\": \"%s\",\n", collisions == Universe::UNIFORM_GRID ? "grid" : "brute" );
+    static const char* gravityNames[] = { "pairwise", "barnes-hut", "barnes-hut-checked" };
+    printf( "  \"gravity\": \"%s\",\n", gravityNames[gravity] );
+    printf( "  \"theta\": %g,\n", universe.openingAngle() );
+    printf( "  \"kernels\": \"%s\",\n", kernelPath() == AVX2_KERNELS ? "avx2" : "scalar" );
+    printf( "  \"active_radius\": %g,\n", activeRadius );
+    printf( "  \"swept\": %s,\n", swept ? "true" : "false" );
+    printf( "  \"contact_iterations\": %d,\n", contactIterations );
+    printf( "  \"draw\": %s,\n", draw ? "true" : "false" );
+    printf( "  \"seconds\": %.6f,\n", seconds );
+    printf( "  \"steps_per_second\": %.3f,\n", seconds > 0 ? steps / seconds : 0.0 );
+    printf( "  \"solid_steps\": %llu,\n", solidSteps );
+    printf( "  \"ns_per_solid_step\": %.3f,\n", solidSteps ? double(elapsed) / solidSteps : 0.0 );
+    printf( "  \"phases_ns\": {" );
+    for( int phase = 0; phase < Universe::PHASES; phase++ ) {
+        printf( "%s\"%s\": %llu", phase ? ", " : " ", phaseNames[phase],
+                universe.phaseTime( Universe::Phase(phase) ) - before[phase] );
+    }
+    printf( " },\n" );
+    printf( "  \"pools\": {" );
+    SolidPool* pools[] = { &misslePool(), &explosionPool() };
+    for( int i = 0; i < 2; i++ ) {
+        const SolidPool::Stats& stats = pools[i]->stats();
+        printf( "%s\"%s\": { \"requests\": %lu, \"hits\": %lu, \"hit_rate\": %.4f, \"overflows\": %lu, \"size\": %lu, \"high_water\": %lu }",
+                i ? ",\n             " : " ", pools[i]->name(), stats.requests, stats.hits, pools[i]->hitRate(),
+                stats.overflows, (unsigned long)stats.size, (unsigned long)pools[i]->highWater() );
+    }
+    printf( " },\n" );
+    const ContactSolver::Stats& contacts = universe.contactStats();
+    printf( "  \"contacts\": { \"per_step\": %.3f, \"warm_started\": %.4f },\n",
+            contacts.steps ? double(contacts.contacts) / contacts.steps : 0.0,
+            contacts.contacts ? double(contacts.warmStarted) / contacts.contacts : 0.0 );
+    ImageStore::Stats images = ImageStore::stats();
+    printf( "  \"images\": { \"requests\": %lu, \"loads\": %lu, \"placeholders\": %lu, \"stored\": %lu },\n",
+            images.requests, images.loads, images.placeholders, (unsigned long)images.images );
+    printf( "  \"rock_speed\": %.6f", rockSpeed );
+    if ( gravity == Universe::BARNES_HUT_CHECKED ) {
+        printf( ",\n  \"gravity_error\": { \"mean\": %.6g, \"worst\": %.6g, \"bodies\": %.1f }",
+                errorBodies ? errorSum / errorBodies : 0.0, errorWorst, steps > 0 ? double(errorBodies) / steps : 0.0 );
+    }
+    if ( draw ) {
+        RotationCache::Stats rotations = RotationCache::stats();
+        unsigned long drawn = rotations.hits + rotations.misses;
+        printf( ",\n  \"rotations\": { \"steps\": %d, \"hits\": %lu, \"misses\": %lu, \"hit_rate\": %.4f, "
+                "\"evictions\": %lu, \"packed\": %lu, \"entries\": %lu, \"bytes\": %lu, \"budget\": %lu }",
+                RotationCache::steps(), rotations.hits, rotations.misses, drawn ? double(rotations.hits) / drawn : 0.0,
+                rotations.evictions, rotations.packed, (unsigned long)rotations.entries, (unsigned long)rotations.bytes,
+                (unsigned long)RotationCache::budget() );
+        const Universe::Culling& culling = universe.culling();
+        printf( ",\n  \"culling\": { \"margin\": %g, \"frames\": %lu, \"drawn_per_frame\": %.3f, \"culled_per_frame\": %.3f }",
+                universe.cullMargin(), culling.frames,
+                culling.frames ? double(culling.drawn) / culling.frames : 0.0,
+                culling.frames ? double(culling.culled) / culling.frames : 0.0 );
+        const Screen::Stats& presented = screen.stats();
+        printf( ",\n  \"screen\": { \"paint_threads\": %d, \"dirty_rects\": %s, \"full_frames\": %.4f, \"rects_per_frame\": %.3f, \"pixels_per_frame\": %.0f }",
+                screen.threads(), presentation == Screen::DIRTY_RECTS ? "true" : "false",
+                presented.frames ? double(presented.full) / presented.frames : 0.0,
+                presented.frames ? double(presented.rects) / presented.frames : 0.0,
+                presented.frames ? double(presented.pixels) / presented.frames : 0.0 );
+        const Background::Stats& tiles = background.stats();
+        printf( ",\n  \"background\": { \"layers\": %d, \"composed\": %lu, \"blits_per_frame\": %.3f }",
+                parallax > 0 ? 2 : 1, tiles.composed, tiles.frames ? double(tiles.blits) / tiles.frames : 0.0 );
+    }
+    if ( replayFile ) {
+        unsigned long long digest = universe.digest();
+        printf( ",\n  \"digest\": \"%016llx\"", digest );
+        if ( journal.hasDigest ) {
+            printf( ",\n  \"digest_matches\": %s", digest == journal.digest ? "true" : "false" );
+        }
+    }
+    printf( "\n}\n" );
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+/*
+  Implementation for UniformGrid
+
+  Each cell only looks at its "forward" neighbors: the cell to the right,
+the cell below, and the two diagonals on the right.  The other four neighbors
+will see this cell as one of their forward neighbors, so every pair of
+adjacent cells is visited exactly once.
+
+*/
+
+#include <algorithm>
+#include <math.h>
+
+#include "broadphase.h"
+
+namespace PatternSpace {
+
+/*********************  UniformGrid  *********************/
+    UniformGrid::UniformGrid():
+        size(1), sorted(true)
+    {}
+
+    UniformGrid& UniformGrid::clear(double cellSize)
+    {
+        // a degenerate cell size would put everything in its own cell.
+        size = cellSize > 0 ? cellSize : 1;
+        entries.clear();
+        sorted = true;
+        return *this;
+    }
+
+    UniformGrid& UniformGrid::insert(int index, Vector2d position)
+    {
+        Entry entry;
+        entry.cell = cellKey( (long long)floor(position.x() / size),
+                              (long long)floor(position.y() / size) );
+        entry.index = index;
+        entries.push_back(entry);
+        sorted = false;
+        return *this;
+    }
+
+    long long UniformGrid::cellKey(long long column, long long row)
+    {
+        // only equality matters for neighbor lookups, so it's fine that
+        // negative rows wrap around in the low word.
+        return (column << 32) | (row & 0xFFFFFFFFLL);
+    }
+
+    void UniformGrid::findCell(long long cell, size_t& begin, size_t& end) const
+    {
+        Entry probe;
+        probe.cell = cell;
+        probe.index = -1;
+        std::vector<Entry>::const_iterator first =
+            std::lower_bound(entries.begin(), entries.end(), probe);
+        std::vector<Entry>::const_iterator last = first;
+        while ( last != entries.end() && last->cell == cell ) last++;
+        begin = first - entries.begin();
+        end = last - entries.begin();
+    }
+
+    void UniformGrid::pairs(std::vector<Pair>& candidates)
+    {
+        if ( !sorted ) {
+            std::sort(entries.begin(), entries.end());
+            sorted = true;
+        }
+        size_t firstNew = candidates.size();
+
+        // forward neighbors, as (column, row) offsets.
+        static const int forward[4][2] = { {1,-1}, {1,0}, {1,1}, {0,1} };
+
+        size_t begin = 0;
+        while ( begin < entries.size() ) {
+            long long cell = entries[begin].cell;
+            size_t end = begin;
+            while ( end < entries.size() && entries[end].cell == cell ) end++;
+
+            // pairs within the same cell; indexes are already ascending.
+            for( size_t a = begin; a < end; a++ ) {
+                for( size_t b = a + 1; b < end; b++ ) {
+                    candidates.push_back( Pair(entries[a].index, entries[b].index) );
+                }
+            }
+
+            // pairs between this cell and its forward neighbors
+            long long column = cell >> 32;
+            long long row = (long long)(int)(cell & 0xFFFFFFFFLL);
+            for( int n = 0; n < 4; n++ ) {
+                size_t nbegin, nend;
+                findCell( cellKey(column + forward[n][0], row + forward[n][1]), nbegin, nend);
+                for( size_t a = begin; a < end; a++ ) {
+                    for( size_t b = nbegin; b < nend; b++ ) {
+                        int i = entries[a].index;
+                        int j = entries[b].index;
+                        candidates.push_back( i < j ? Pair(i,j) : Pair(j,i) );
+                    }
+                }
+            }
+            begin = end;
+        }
+
+        // visit pairs in the same order as the brute force loop
+        std::sort(candidates.begin() + firstNew, candidates.end());
+    }
+
+} // end namespace PatternSpace
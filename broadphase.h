@@ -0,0 +1,72 @@
+/*
+  UniformGrid
+
+  A broadphase for collision detection.  Testing every pair of Solids for
+contact is n^2, but almost all of those pairs are hundreds of pixels apart.
+UniformGrid hashes each Mass into a square cell, and only reports pairs that
+fall into the same or adjacent cells as candidates for the real (narrowphase)
+test.
+
+  The cell size is chosen by the caller; it must be at least twice the largest
+radius in the grid.  Then any two circles that overlap must have their centers
+in the same cell or in neighboring cells, and we never miss a contact.
+
+  The grid is rebuilt from scratch every step.  Rather than a real hash table,
+the entries are simply sorted by cell, so each cell is a contiguous run and
+its neighbors can be found with a binary search.  That keeps the memory
+compact and makes the order of the candidate pairs deterministic.
+
+Usage:
+  clear() the grid with a cell size, insert() each Mass position with an
+index of your choosing, and then ask for the candidate pairs().  Each pair
+(i,j) is reported exactly once, with i < j, in ascending order, which is the
+same order the brute force loop would visit them in.
+
+*/
+#ifndef PATTERN_SPACE_BROADPHASE_INCLUSION_GUARD
+#define PATTERN_SPACE_BROADPHASE_INCLUSION_GUARD
+
+#include <vector>
+#include <utility>
+
+#include "vector2d.h"
+
+namespace PatternSpace {
+
+/*********************  UniformGrid  *********************/
+    class UniformGrid {
+    public:
+        typedef std::pair<int,int> Pair;
+
+        UniformGrid();
+
+        UniformGrid& clear(double cellSize);
+        UniformGrid& insert(int index, Vector2d position);
+
+        // appends the candidate pairs to the given vector.
+        void pairs(std::vector<Pair>& candidates);
+
+        double cellSize() const { return size; }
+        int count() const { return int(entries.size()); }
+
+    private:
+        struct Entry {
+            long long cell;  // packed (column, row) of the cell
+            int index;
+            bool operator<(const Entry& other) const {
+                if ( cell != other.cell ) return cell < other.cell;
+                return index < other.index;
+            }
+        };
+
+        static long long cellKey(long long column, long long row);
+        // finds the run of entries in a given cell.
+        void findCell(long long cell, size_t& begin, size_t& end) const;
+
+        double size;
+        bool sorted;
+        std::vector<Entry> entries;
+    }; // end class UniformGrid
+
+} // end namespace PatternSpace
+#endif  // PATTERN_SPACE_BROADPHASE_INCLUSION_GUARD
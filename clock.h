@@ -0,0 +1,32 @@
+/*
+  nanoseconds()
+
+  SDL_GetTicks() only counts milliseconds, which is far too coarse for timing
+a lock or a single phase of a step.  nanoseconds() reads the monotonic clock
+where there is one, and falls back on SDL_GetTicks() where there isn't.  Only
+differences between two readings mean anything.
+
+*/
+#ifndef PATTERN_SPACE_CLOCK_INCLUSION_GUARD
+#define PATTERN_SPACE_CLOCK_INCLUSION_GUARD
+
+#include <SDL/SDL.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <time.h>
+#endif
+
+namespace PatternSpace {
+
+    inline unsigned long long nanoseconds()
+    {
+#if defined(CLOCK_MONOTONIC)
+        timespec now;
+        clock_gettime( CLOCK_MONOTONIC, &now );
+        return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+#else
+        return (unsigned long long)SDL_GetTicks() * 1000000ULL;
+#endif
+    }
+
+} // end namespace PatternSpace
+#endif  // PATTERN_SPACE_CLOCK_INCLUSION_GUARD
@@ -0,0 +1,188 @@
+/*
+  Implementation for ContactSolver
+
+  Each body's velocity is copied out of its Mass when it first turns up in
+a contact, and the iterations work on the copies.  Only at the end are the
+accumulated impulses handed to the Masses, one per contact on each side.  A
+contact that bounces is an impact, and is applied with hit(), so the Solid
+is damaged just as with collision().  One that's only holding two Masses
+apart is a steady force, and is applied with push() over the step; rocks
+resting against each other shouldn't grind each other to dust.
+
+  Last step's contacts are kept sorted by their pair of keys, so a
+contact's warm start is a binary search.  A pair is always keyed the same
+way round, whichever order it was added in.
+
+*/
+
+#include <algorithm>
+
+#include "contactsolver.h"
+
+namespace PatternSpace {
+
+/*********************  ContactSolver  *********************/
+    const double ContactSolver::RESTING_SPEED = .5;
+
+    // how much of the overlap to take out each step, and how much to leave,
+    // in pixels, so that resting contacts stay in contact.
+    static const double CORRECTION = .5;
+    static const double SLOP = .5;
+
+    ContactSolver::ContactSolver(int iterations):
+        passes(iterations), x(0), y(0), vx(0), vy(0), radius(0), key(0), sweep(0)
+    {
+        counts.contacts = counts.warmStarted = counts.steps = 0;
+    }
+
+    ContactSolver& ContactSolver::iterations(int count)
+    {
+        passes = count > 0 ? count : 0;
+        return *this;
+    }
+
+    int ContactSolver::iterations() const
+    {
+        return passes;
+    }
+
+    const ContactSolver::Stats& ContactSolver::stats() const
+    {
+        return counts;
+    }
+
+    ContactSolver& ContactSolver::begin(int count, const double* x, const double* y,
+                                        const double* vx, const double* vy, const double* radius,
+                                        const unsigned long* key, double sweep)
+    {
+        this->x = x;
+        this->y = y;
+        this->vx = vx;
+        this->vy = vy;
+        this->radius = radius;
+        this->key = key;
+        this->sweep = sweep;
+        bodyOf.assign( count, -1 );
+        bodies.clear();
+        constraints.clear();
+        return *this;
+    }
+
+    int ContactSolver::body(int index, Mass& mass)
+    {
+        if ( bodyOf[index] < 0 ) {
+            Body body;
+            body.mass = &mass;
+            body.inverseMass = mass.mass() > 0 ? 1 / mass.mass() : 0;
+            body.vx = vx[index];
+            body.vy = vy[index];
+            bodyOf[index] = int( bodies.size() );
+            bodies.push_back(body);
+        }
+        return bodyOf[index];
+    }
+
+    ContactSolver& ContactSolver::contact(int i, Mass& m1, int j, Mass& m2)
+    {
+        Vector2d R( x[j] - x[i], y[j] - y[i] );
+        double overlap = ( radius[i] + radius[j] ) - R.magnitude();
+        if ( overlap < 0 ) {
+            // not touching yet, but sweptCollision() may catch them on the way.
+            if ( sweep > 0 ) sweptCollision( m1, m2, sweep );
+            return *this;
+        }
+        Vector2d axis = R.unit();
+
+        Constraint constraint;
+        constraint.body1 = body( i, m1 );
+        constraint.body2 = body( j, m2 );
+        constraint.key1 = std::min( key[i], key[j] );
+        constraint.key2 = std::max( key[i], key[j] );
+        constraint.axisX = axis.x();
+        constraint.axisY = axis.y();
+        constraint.overlap = overlap;
+        double inverse = bodies[constraint.body1].inverseMass + bodies[constraint.body2].inverseMass;
+        constraint.effectiveMass = inverse > 0 ? 1 / inverse : 0;
+        // closing speeds are negative.
+        const Body& body1 = bodies[constraint.body1];
+        const Body& body2 = bodies[constraint.body2];
+        double closing = ( body2.vx - body1.vx ) * axis.x() + ( body2.vy - body1.vy ) * axis.y();
+        constraint.target = closing < -RESTING_SPEED ? -closing : 0;
+        constraint.impulse = 0;
+        constraints.push_back(constraint);
+        return *this;
+    }
+
+    double ContactSolver::lastImpulse(const Constraint& constraint) const
+    {
+        std::vector<Constraint>::const_iterator pLast =
+            std::lower_bound( previous.begin(), previous.end(), constraint );
+        if ( pLast == previous.end() || pLast->key1 != constraint.key1 || pLast->key2 != constraint.key2 ) return 0;
+        return pLast->impulse;
+    }
+
+    // push the two bodies of a contact apart by impulse.
+    void ContactSolver::apply(const Constraint& constraint, double impulse)
+    {
+        Body& body1 = bodies[constraint.body1];
+        Body& body2 = bodies[constraint.body2];
+        body1.vx -= constraint.axisX * impulse * body1.inverseMass;
+        body1.vy -= constraint.axisY * impulse * body1.inverseMass;
+        body2.vx += constraint.axisX * impulse * body2.inverseMass;
+        body2.vy += constraint.axisY * impulse * body2.inverseMass;
+    }
+
+    ContactSolver& ContactSolver::solve(double deltaTime)
+    {
+        counts.steps++;
+        counts.contacts += constraints.size();
+
+        std::vector<Constraint>::iterator pConstraint;
+        for( pConstraint = constraints.begin(); pConstraint != constraints.end(); pConstraint++ ) {
+            pConstraint->impulse = lastImpulse(*pConstraint);
+            if ( pConstraint->impulse > 0 ) {
+                counts.warmStarted++;
+                apply( *pConstraint, pConstraint->impulse );
+            }
+        }
+
+        for( int pass = 0; pass < passes; pass++ ) {
+            for( pConstraint = constraints.begin(); pConstraint != constraints.end(); pConstraint++ ) {
+                const Body& body1 = bodies[pConstraint->body1];
+                const Body& body2 = bodies[pConstraint->body2];
+                double normal = ( body2.vx - body1.vx ) * pConstraint->axisX
+                              + ( body2.vy - body1.vy ) * pConstraint->axisY;
+                // contacts push, they never pull.
+                double total = pConstraint->impulse + pConstraint->effectiveMass * ( pConstraint->target - normal );
+                if ( total < 0 ) total = 0;
+                apply( *pConstraint, total - pConstraint->impulse );
+                pConstraint->impulse = total;
+            }
+        }
+
+        for( pConstraint = constraints.begin(); pConstraint != constraints.end(); pConstraint++ ) {
+            const Body& body1 = bodies[pConstraint->body1];
+            const Body& body2 = bodies[pConstraint->body2];
+            Vector2d axis( pConstraint->axisX, pConstraint->axisY );
+            if ( pConstraint->impulse > 0 && pConstraint->target > 0 ) {
+                body1.mass->hit( -axis * pConstraint->impulse );
+                body2.mass->hit( axis * pConstraint->impulse );
+            } else if ( pConstraint->impulse > 0 && deltaTime > 0 ) {
+                Vector2d force = axis * ( pConstraint->impulse / deltaTime );
+                body1.mass->push( -force );
+                body2.mass->push( force );
+            }
+            double correction = CORRECTION * ( pConstraint->overlap - SLOP );
+            double inverse = body1.inverseMass + body2.inverseMass;
+            if ( correction > 0 && inverse > 0 ) {
+                body1.mass->translate( -axis * ( correction * body1.inverseMass / inverse ) );
+                body2.mass->translate( axis * ( correction * body2.inverseMass / inverse ) );
+            }
+        }
+
+        previous.swap(constraints);
+        std::sort( previous.begin(), previous.end() );
+        return *this;
+    }
+
+} // end namespace PatternSpace
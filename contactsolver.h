@@ -0,0 +1,125 @@
+/*
+  ContactSolver
+
+  collision() deals with one pair at a time: it shoves the two Masses apart
+by the whole of their overlap (and a pixel) and bounces them elastically.
+That's fine for a missile hitting a rock, but in a cluster of rocks held
+together by gravity every rock is touching several others, each shove pushes
+a rock into its other neighbors, and gravity pulls them all back in again,
+so the cluster jitters forever and the same work is done every step.
+
+  A ContactSolver solves all the contacts of a step together, with
+sequential impulses.  Each contact gets an impulse along its axis, which
+may push but never pull, and the contacts are gone through over and over,
+each one correcting its impulse for what the others have done to its two
+Masses' velocities, until they agree.  A contact that closes faster than
+RESTING_SPEED bounces elastically, just as collision() would; a slower one
+only stops closing, so the Masses come to rest against each other.  The
+overlap is taken out a part at a time, in proportion to the Masses, rather
+than all at once.
+
+  The contacts are remembered from one step to the next, and a contact that
+was there last step starts from the impulse it ended with (warm starting),
+so a cluster at rest needs very few iterations to stay at rest.  A contact
+is known by the keys of its two bodies, which the caller gives; they must
+never be reused for a different body, or it'll inherit that body's impulses.
+
+  The contacts are found and solved in one thread, in the order they were
+added, so the results are the same however they were found.
+
+Usage:
+  Every step, begin() with the number of bodies, their positions and radii,
+and the velocities they'll have once the forces already pushed on them this
+step are in (otherwise the solver can't hold up a Mass against, say,
+gravity.)  Then add every candidate pair of bodies with contact(), and
+solve() with the length of the step.  Pairs that aren't touching are
+ignored, unless begin() was given a sweep; then they're left to
+sweptCollision(), which may catch them.  The impulses are applied to the
+Masses with hit() or push(), and the overlaps corrected with translate().
+
+*/
+#ifndef PATTERN_SPACE_CONTACT_SOLVER_INCLUSION_GUARD
+#define PATTERN_SPACE_CONTACT_SOLVER_INCLUSION_GUARD
+
+#include <vector>
+
+#include "mass.h"
+
+namespace PatternSpace {
+
+/*********************  ContactSolver  *********************/
+    class ContactSolver {
+    public:
+        // counted over every step solved.
+        struct Stats {
+            unsigned long contacts;
+            unsigned long warmStarted;    // contacts that were there last step
+            unsigned long steps;
+        };
+
+        // pixels per REFERENCE_STEP; see above.
+        static const double RESTING_SPEED;
+
+        // zero iterations turns the solver off.
+        explicit ContactSolver(int iterations = 0);
+
+        ContactSolver& iterations(int count);
+        int iterations() const;
+
+        // start a step, with bodies numbered from zero to bodies - 1, at
+        // (x, y), whose velocities will be (vx, vy), and known from one step
+        // to the next by key.
+        ContactSolver& begin(int bodies, const double* x, const double* y,
+                             const double* vx, const double* vy, const double* radius,
+                             const unsigned long* key, double sweep = 0);
+        // body i is m1 and body j is m2.
+        ContactSolver& contact(int i, Mass& m1, int j, Mass& m2);
+        // solve the contacts, and apply the impulses to a step of deltaTime.
+        ContactSolver& solve(double deltaTime);
+
+        const Stats& stats() const;
+
+    private:
+        struct Body {
+            Mass* mass;
+            double inverseMass;
+            double vx, vy;
+        };
+        struct Constraint {
+            int body1, body2;         // into bodies
+            unsigned long key1;       // which pair it was
+            unsigned long key2;
+            double axisX, axisY;      // from body1 to body2
+            double overlap;
+            double effectiveMass;
+            double target;            // normal velocity to end up with
+            double impulse;           // accumulated
+            bool operator<(const Constraint& other) const {
+                if ( key1 != other.key1 ) return key1 < other.key1;
+                return key2 < other.key2;
+            }
+        };
+
+        int body(int index, Mass& mass);
+        // the impulse the same pair ended last step with, or zero.
+        double lastImpulse(const Constraint& constraint) const;
+        void apply(const Constraint& constraint, double impulse);
+
+        int passes;
+        // by body number
+        const double* x;
+        const double* y;
+        const double* vx;
+        const double* vy;
+        const double* radius;
+        const unsigned long* key;
+        double sweep;                 // for pairs not touching yet
+        std::vector<int> bodyOf;      // by body number, or -1
+        std::vector<Body> bodies;
+        std::vector<Constraint> constraints;
+        std::vector<Constraint> previous;   // last step's, sorted by key
+        Stats counts;
+    }; // end class ContactSolver
+
+} // end namespace PatternSpace
+#endif  // PATTERN_SPACE_CONTACT_SOLVER_INCLUSION_GUARD
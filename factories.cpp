@@ -1,95 +1,209 @@
-/* 
-  Factory functions.  To build a Solid, you need to instantiate at least
-one Mass and at least one Image.  You have to make several choices about 
-which implementation class to use, and you have to provide a whole slew of
-parameters, so it's best to encapsulate those decisions here.  This is the
-weakest module in the program, but hey, at least it's encapsulated!
-
-  This module needs the support of background loading (seperate thread), a 
-resource control class, and a meta-data file format for defining new Solid
-classes.  In fact, it needs a complete overhaul.  
-
-*/
-
-#include <stdio.h>
-#include <stdlib.h>
-#include "factories.h"
-
-namespace PatternSpace {
-    
-    boost::shared_ptr<Solid> newRock(Vector2d initialPosition, Vector2d initialVelocity) 
-    {        
-        std::auto_ptr<Mass> pMass( new NewtonianMass(1000,2000,20,initialPosition,initialVelocity,0.,.1) );
-        std::auto_ptr<Image> pImage( new BitmapImage("images/rock.bmp") );
-        
-        boost::shared_ptr<Solid> pRock ( new NormalSolid(pMass, pImage, 5000, 0, 0 ) );
-        return pRock;
-    }
-    
-    boost::shared_ptr<Solid> newBigRock(Vector2d initialPosition, Vector2d initialVelocity) 
-    {        
-        std::auto_ptr<Mass> pMass( new NewtonianMass(5000,10000,35,initialPosition,initialVelocity,0.,.1) );
-        std::auto_ptr<Image> pImage( new BitmapImage("images/big-rock.bmp") );
-        
-        boost::shared_ptr<Solid> pRock ( new NormalSolid(pMass, pImage, 15000, 0, 0 ) );
-        return pRock;
-    }
-    
-    boost::shared_ptr<Solid> newAlien(Vector2d initialPosition, Vector2d initialVelocity) 
-    {
-        boost::shared_ptr<Image> pa1( new BitmapImage("images/alien1-1.bmp") );
-        boost::shared_ptr<Image> pa2( new BitmapImage("images/alien1-2.bmp") );
-        boost::shared_ptr<Image> pa3( new BitmapImage("images/alien1-3.bmp") );
-        std::auto_ptr<AnimatedImage> paa( new AnimatedImage(pa1,5) );
-        paa->add(pa2);
-        paa->add(pa3);
-        std::auto_ptr<Image> paa2(paa);
-        Vector2d p(500,300);
-        Vector2d v(0,.1);
-        std::auto_ptr<Mass> pAlienMass( new NewtonianMass(100,200,12,initialPosition,initialVelocity,0,0) );
-        boost::shared_ptr<Solid> pAlien(new NormalSolid( pAlienMass, paa2, 200, 0, 1) );
-        return pAlien;
-    }
-    
-    boost::shared_ptr<Solid> newExplosion(Vector2d initialPosition, Vector2d initialVelocity) 
-    {
-        boost::shared_ptr<Image> pi1( new BitmapImage("images/explode1.bmp") );
-        boost::shared_ptr<Image> pi2( new BitmapImage("images/explode2.bmp") );
-        boost::shared_ptr<Image> pi3( new BitmapImage("images/explode3.bmp") );
-        boost::shared_ptr<Image> pi4( new BitmapImage("images/explode4.bmp") );
-        boost::shared_ptr<Image> pi5( new BitmapImage("images/explode5.bmp") );
-        boost::shared_ptr<Image> pi6( new BitmapImage("images/explode6.bmp") );
-        boost::shared_ptr<Image> pi7( new BitmapImage("images/explode7.bmp") );
-        
-        std::auto_ptr<AnimatedImage> pai( new AnimatedImage(pi1,2) );
-        pai->add(pi2)
-            .add(pi3)
-            .add(pi4)
-            .add(pi5)
-            .add(pi6)
-            .add(pi7);
-        std::auto_ptr<Image> pai2(pai);
-        std::auto_ptr<Mass> pMass( new NewtonianMass(100,200,10,initialPosition,initialVelocity,0.,.1) );
-        boost::shared_ptr<Solid> pExplosion(new NormalSolid( pMass, pai2, 100, 50, 2) );
-        return pExplosion;
-    }
-
-    boost::shared_ptr<Ship> newShip(Vector2d initialPosition, Vector2d initialVelocity)
-    {
-        BitmapImage shipImage("images/ship.bmp");    
-        std::auto_ptr<Mass> pShipMass( new FrictionMass(100,2000,12,initialPosition,initialVelocity,0,0,.0002,.002) );
-        std::auto_ptr<Image> pShipImage( new BitmapImage(shipImage) );
-        boost::shared_ptr<Ship> pShip( new Ship(pShipMass, pShipImage) );
-        return pShip;
-    }
-    
-    boost::shared_ptr<Solid> newMissle(Vector2d initialPosition, Vector2d initialVelocity)
-    {
-        BitmapImage missleImage("images/missle1.bmp");    
-        std::auto_ptr<Mass> pMass( new LinearMass(30,60,5,initialPosition,initialVelocity) );
-        std::auto_ptr<Image> pImage( new BitmapImage(missleImage) );
-        boost::shared_ptr<Solid> pMissle( new NormalSolid(pMass, pImage,2,500,4 ) );
-        return pMissle;
-    }
-
-} // end namespace PatternSpace
+/* 
+  Factory functions.  To build a Solid, you need to instantiate at least
+one Mass and at least one Image.  You have to make several choices about 
+which implementation class to use, and you have to provide a whole slew of
+parameters, so it's best to encapsulate those decisions here.  This is the
+weakest module in the program, but hey, at least it's encapsulated!
+
+  This module needs the support of a meta-data file format for defining new
+Solid classes.  In fact, it needs a complete overhaul.  
+
+  The Images all come from the ImageStore, so each file is only read from
+disk the first time it's used, and every Solid of a kind shares its Surfaces.
+If the ImageStore is loading in the background, a Solid whose images aren't
+in yet is made anyway, with placeholders, rather than waiting for them.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "factories.h"
+#include "universe.h"
+#include "imagestore.h"
+
+namespace PatternSpace {
+    
+    boost::shared_ptr<Solid> newRock(Vector2d initialPosition, Vector2d initialVelocity) 
+    {        
+        std::auto_ptr<Mass> pMass( new NewtonianMass(1000,2000,20,initialPosition,initialVelocity,0.,.1) );
+        std::auto_ptr<Image> pImage( new BitmapImage( ImageStore::bitmap("images/rock.bmp") ) );
+        
+        boost::shared_ptr<Solid> pRock ( new NormalSolid(pMass, pImage, 5000, 0, INANIMATE ) );
+        return pRock;
+    }
+    
+    boost::shared_ptr<Solid> newBigRock(Vector2d initialPosition, Vector2d initialVelocity) 
+    {        
+        std::auto_ptr<Mass> pMass( new NewtonianMass(5000,10000,35,initialPosition,initialVelocity,0.,.1) );
+        std::auto_ptr<Image> pImage( new BitmapImage( ImageStore::bitmap("images/big-rock.bmp") ) );
+        
+        boost::shared_ptr<Solid> pRock ( new NormalSolid(pMass, pImage, 15000, 0, INANIMATE ) );
+        return pRock;
+    }
+    
+    boost::shared_ptr<Solid> newAlien(Vector2d initialPosition, Vector2d initialVelocity) 
+    {
+        boost::shared_ptr<Image> pa1( ImageStore::image("images/alien1-1.bmp") );
+        boost::shared_ptr<Image> pa2( ImageStore::image("images/alien1-2.bmp") );
+        boost::shared_ptr<Image> pa3( ImageStore::image("images/alien1-3.bmp") );
+        std::auto_ptr<AnimatedImage> paa( new AnimatedImage(pa1,5) );
+        paa->add(pa2);
+        paa->add(pa3);
+        std::auto_ptr<Image> paa2(paa);
+        Vector2d p(500,300);
+        Vector2d v(0,.1);
+        std::auto_ptr<Mass> pAlienMass( new NewtonianMass(100,200,12,initialPosition,initialVelocity,0,0) );
+        boost::shared_ptr<Solid> pAlien(new NormalSolid( pAlienMass, paa2, 200, 0, ENEMY) );
+        return pAlien;
+    }
+    
+    static boost::shared_ptr<NormalSolid> makeExplosion(Vector2d initialPosition, Vector2d initialVelocity) 
+    {
+        boost::shared_ptr<Image> pi1( ImageStore::image("images/explode1.bmp") );
+        boost::shared_ptr<Image> pi2( ImageStore::image("images/explode2.bmp") );
+        boost::shared_ptr<Image> pi3( ImageStore::image("images/explode3.bmp") );
+        boost::shared_ptr<Image> pi4( ImageStore::image("images/explode4.bmp") );
+        boost::shared_ptr<Image> pi5( ImageStore::image("images/explode5.bmp") );
+        boost::shared_ptr<Image> pi6( ImageStore::image("images/explode6.bmp") );
+        boost::shared_ptr<Image> pi7( ImageStore::image("images/explode7.bmp") );
+        
+        std::auto_ptr<AnimatedImage> pai( new AnimatedImage(pi1,2) );
+        pai->add(pi2)
+            .add(pi3)
+            .add(pi4)
+            .add(pi5)
+            .add(pi6)
+            .add(pi7);
+        std::auto_ptr<Image> pai2(pai);
+        std::auto_ptr<Mass> pMass( new NewtonianMass(100,200,10,initialPosition,initialVelocity,0.,.1) );
+        boost::shared_ptr<NormalSolid> pExplosion(new NormalSolid( pMass, pai2, 100, 50, EFFECT) );
+        return pExplosion;
+    }
+
+    boost::shared_ptr<Solid> newExplosion(Vector2d initialPosition, Vector2d initialVelocity) 
+    {
+        return explosionPool().acquire( initialPosition, initialVelocity );
+    }
+
+    boost::shared_ptr<Ship> newShip(Vector2d initialPosition, Vector2d initialVelocity)
+    {
+        std::auto_ptr<Mass> pShipMass( new FrictionMass(100,2000,12,initialPosition,initialVelocity,0,0,.0002,.002) );
+        std::auto_ptr<Image> pShipImage( new BitmapImage( ImageStore::bitmap("images/ship.bmp") ) );
+        boost::shared_ptr<Ship> pShip( new Ship(pShipMass, pShipImage) );
+        return pShip;
+    }
+    
+    static boost::shared_ptr<NormalSolid> makeMissle(Vector2d initialPosition, Vector2d initialVelocity)
+    {
+        std::auto_ptr<Mass> pMass( new LinearMass(30,60,5,initialPosition,initialVelocity) );
+        std::auto_ptr<Image> pImage( new BitmapImage( ImageStore::bitmap("images/missle1.bmp") ) );
+        boost::shared_ptr<NormalSolid> pMissle( new NormalSolid(pMass, pImage,2,500,PROJECTILE ) );
+        return pMissle;
+    }
+
+    boost::shared_ptr<Solid> newMissle(Vector2d initialPosition, Vector2d initialVelocity)
+    {
+        return misslePool().acquire( initialPosition, initialVelocity );
+    }
+
+/*********************  SolidPool  *********************/
+    SolidPool::SolidPool(const char* name, Factory make, size_t highWater):
+        poolName(name), make(make), angle(0), rotation(0), limit(highWater), next(0)
+    {
+        counts.requests = counts.hits = counts.overflows = 0;
+        counts.size = 0;
+    }
+
+    // the Solids are tried in turn, starting after the last one handed out,
+    // so the first one tried is the one that's been out the longest, which
+    // is the one most likely to be free.  Only a Solid make() has built can
+    // be restarted, so angle and rotation are always known by then.
+    boost::shared_ptr<Solid> SolidPool::acquire(Vector2d position, Vector2d velocity)
+    {
+        counts.requests++;
+        for( size_t tried = 0; tried < solids.size(); tried++ ) {
+            if ( next >= solids.size() ) next = 0;
+            boost::shared_ptr<NormalSolid>& pSolid = solids[next++];
+            if ( pSolid.unique() ) {
+                pSolid->restart( position, velocity, angle, rotation );
+                counts.hits++;
+                return pSolid;
+            }
+        }
+
+        boost::shared_ptr<NormalSolid> pSolid = make( position, velocity );
+        angle = pSolid->angle();
+        rotation = pSolid->rotation();
+        if ( solids.size() < limit ) {
+            solids.push_back(pSolid);
+        } else {
+            counts.overflows++;
+        }
+        counts.size = solids.size();
+        return pSolid;
+    }
+
+    SolidPool& SolidPool::highWater(size_t highWater)
+    {
+        limit = highWater;
+        if ( solids.size() > limit ) solids.resize(limit);
+        counts.size = solids.size();
+        return *this;
+    }
+
+    size_t SolidPool::highWater() const
+    {
+        return limit;
+    }
+
+    const SolidPool::Stats& SolidPool::stats() const
+    {
+        return counts;
+    }
+
+    double SolidPool::hitRate() const
+    {
+        return counts.requests ? double(counts.hits) / counts.requests : 0;
+    }
+
+    const char* SolidPool::name() const
+    {
+        return poolName;
+    }
+
+    SolidPool& misslePool()
+    {
+        static SolidPool pool( "missle", makeMissle, 256 );
+        return pool;
+    }
+
+    SolidPool& explosionPool()
+    {
+        static SolidPool pool( "explosion", makeExplosion, 256 );
+        return pool;
+    }
+
+    void reportPools(FILE* out)
+    {
+        SolidPool* pools[] = { &misslePool(), &explosionPool() };
+        fprintf( out, "%-10s %10s %10s %8s %10s %6s\n", "pool", "requests", "hits", "hit %", "overflows", "size" );
+        for( size_t i = 0; i < sizeof(pools) / sizeof(pools[0]); i++ ) {
+            const SolidPool::Stats& stats = pools[i]->stats();
+            fprintf( out, "%-10s %10lu %10lu %8.1f %10lu %6lu\n", pools[i]->name(), stats.requests, stats.hits,
+                     100 * pools[i]->hitRate(), stats.overflows, (unsigned long)stats.size );
+        }
+    }
+
+    void standardInteractions(Universe& universe)
+    {
+        static const int solid[] = { INANIMATE, ENEMY, PLAYER, PROJECTILE };
+        const int kinds = sizeof(solid) / sizeof(solid[0]);
+        for( int i = 0; i < kinds; i++ ) {
+            for( int j = i; j < kinds; j++ ) {
+                universe.interaction( solid[i], solid[j], gravitate );
+                universe.interaction( solid[i], solid[j], collision );
+            }
+        }
+    }
+
+} // end namespace PatternSpace
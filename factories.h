@@ -1,25 +1,81 @@
-/* Factories
-  functions for creating new Solids.
-*/
-
-#ifndef PATTERN_SPACE_FACTORIES_INCLUSION_GUARD
-#define PATTERN_SPACE_FACTORIES_INCLUSION_GUARD
-
-#include <boost/shared_ptr.hpp>
-#include "vector2d.h"
-#include "solid.h"
-#include "ship.h"
-
-namespace PatternSpace {
-
-    boost::shared_ptr<Solid> newRock(Vector2d initialPosition, Vector2d initialVelocity);
-    boost::shared_ptr<Solid> newBigRock(Vector2d initialPosition, Vector2d initialVelocity);
-    boost::shared_ptr<Solid> newAlien(Vector2d initialPosition, Vector2d initialVelocity);
-    boost::shared_ptr<Solid> newExplosion(Vector2d initialPosition, Vector2d intialVelocity);
-    boost::shared_ptr<Ship> newShip(Vector2d initialPosition, Vector2d initialVelocity);
-    boost::shared_ptr<Solid> newMissle(Vector2d initialPosition, Vector2d intialVelocity);
-
-} // end namespace PatternSpace
-
-
-#endif  // PATTERN_SPACE_FACTORIES_INCLUSION_GUARD
+/* Factories
+  functions for creating new Solids.
+
+  Missiles and explosions come and go by the hundred in a firefight, so
+newMissle() and newExplosion() recycle them through a SolidPool rather than
+building a new Solid, Mass and Images every time.  A SolidPool holds on to
+every Solid it hands out, up to its high-water mark.  Once the rest of the
+program has let go of one (the Universe keeps the dead until the painter is
+done with them), the pool restart()s it for the next caller.  Past the high-
+water mark, new Solids are made as usual and not kept.
+*/
+
+#ifndef PATTERN_SPACE_FACTORIES_INCLUSION_GUARD
+#define PATTERN_SPACE_FACTORIES_INCLUSION_GUARD
+
+#include <stdio.h>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "vector2d.h"
+#include "solid.h"
+#include "ship.h"
+
+namespace PatternSpace {
+
+    class Universe;
+
+    boost::shared_ptr<Solid> newRock(Vector2d initialPosition, Vector2d initialVelocity);
+    boost::shared_ptr<Solid> newBigRock(Vector2d initialPosition, Vector2d initialVelocity);
+    boost::shared_ptr<Solid> newAlien(Vector2d initialPosition, Vector2d initialVelocity);
+    boost::shared_ptr<Solid> newExplosion(Vector2d initialPosition, Vector2d intialVelocity);
+    boost::shared_ptr<Ship> newShip(Vector2d initialPosition, Vector2d initialVelocity);
+    boost::shared_ptr<Solid> newMissle(Vector2d initialPosition, Vector2d intialVelocity);
+
+/*********************  SolidPool  *********************/
+    class SolidPool {
+    public:
+        typedef boost::shared_ptr<NormalSolid> (*Factory)(Vector2d position, Vector2d velocity);
+
+        // make() builds a new Solid; restarted ones start at the angle and
+        // rotation make() gave them.
+        SolidPool(const char* name, Factory make, size_t highWater);
+
+        boost::shared_ptr<Solid> acquire(Vector2d position, Vector2d velocity);
+
+        // the most Solids to keep.  Lowering it lets go of the excess.
+        SolidPool& highWater(size_t limit);
+        size_t highWater() const;
+
+        struct Stats {
+            unsigned long requests;
+            unsigned long hits;       // restarted rather than made
+            unsigned long overflows;  // made, but not kept
+            size_t size;              // Solids kept
+        };
+        const Stats& stats() const;
+        double hitRate() const;
+        const char* name() const;
+
+    private:
+        const char* poolName;
+        Factory make;
+        double angle, rotation;       // as make() left the last one
+        size_t limit;
+        std::vector< boost::shared_ptr<NormalSolid> > solids;
+        size_t next;                  // where to start looking
+        Stats counts;
+    }; // end class SolidPool
+
+    SolidPool& misslePool();
+    SolidPool& explosionPool();
+    // a line for each pool.
+    void reportPools(FILE* out);
+
+    // register the game's interactions: everything but the EFFECTs pulls
+    // on and bounces off everything else.
+    void standardInteractions(Universe& universe);
+
+} // end namespace PatternSpace
+
+
+#endif  // PATTERN_SPACE_FACTORIES_INCLUSION_GUARD
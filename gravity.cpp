@@ -0,0 +1,235 @@
+/*
+  Implementation for BarnesHut
+
+  The tree lives in a single vector of Nodes, and the children of a Node are
+always four consecutive entries, in the order top-left, top-right,
+bottom-left, bottom-right.  Bodies that land in the same leaf are chained
+together through Body::next.  Normally a leaf holds one body, but bodies that
+sit on top of each other can't be separated by subdividing, so below
+MAX_DEPTH we simply let the leaf hold all of them.
+
+  Everything is addressed by index rather than by pointer, because the
+vectors may reallocate while the tree is being built.
+
+*/
+
+#include <math.h>
+
+#include "gravity.h"
+#include "mass.h"
+
+namespace PatternSpace {
+
+    static const int MAX_DEPTH = 32;
+
+/*********************  BarnesHut  *********************/
+    BarnesHut::BarnesHut():
+        theta(.5)
+    {}
+
+    BarnesHut& BarnesHut::openingAngle(double newTheta)
+    {
+        theta = newTheta > 0 ? newTheta : 0;
+        return *this;
+    }
+
+    double BarnesHut::openingAngle() const
+    {
+        return theta;
+    }
+
+    BarnesHut& BarnesHut::clear()
+    {
+        bodies.clear();
+        nodes.clear();
+        return *this;
+    }
+
+    int BarnesHut::insert(Vector2d position, double mass, double radius)
+    {
+        Body body;
+        body.x = position.x();
+        body.y = position.y();
+        body.mass = mass;
+        body.radius = radius;
+        body.next = -1;
+        bodies.push_back(body);
+        return int(bodies.size()) - 1;
+    }
+
+    int BarnesHut::newNode(double left, double top, double width)
+    {
+        Node node;
+        node.left = left;
+        node.top = top;
+        node.width = width;
+        node.x = node.y = 0;
+        node.mass = 0;
+        node.maxRadius = 0;
+        node.firstChild = -1;
+        node.firstBody = -1;
+        nodes.push_back(node);
+        return int(nodes.size()) - 1;
+    }
+
+    int BarnesHut::childFor(const Node& node, const Body& body) const
+    {
+        double half = node.width / 2;
+        int child = 0;
+        if ( body.x >= node.left + half ) child += 1;
+        if ( body.y >= node.top + half ) child += 2;
+        return child;
+    }
+
+    BarnesHut& BarnesHut::build()
+    {
+        nodes.clear();
+        if ( bodies.empty() ) return *this;
+
+        // find the bounding square of all the bodies.
+        double left = bodies[0].x, right = bodies[0].x;
+        double top = bodies[0].y, bottom = bodies[0].y;
+        std::vector<Body>::iterator pBody;
+        for( pBody = bodies.begin(); pBody != bodies.end(); pBody++ ) {
+            if ( pBody->x < left ) left = pBody->x;
+            if ( pBody->x > right ) right = pBody->x;
+            if ( pBody->y < top ) top = pBody->y;
+            if ( pBody->y > bottom ) bottom = pBody->y;
+        }
+        double width = (right - left) > (bottom - top) ? (right - left) : (bottom - top);
+        // pad it so the bodies on the far edges still fall inside.
+        width = width * 1.0001 + 1;
+
+        nodes.reserve( 2 * bodies.size() );
+        newNode(left, top, width);
+        for( int body = 0; body < int(bodies.size()); body++ ) {
+            insertBody(0, body, 0);
+        }
+        summarize(0);
+        return *this;
+    }
+
+    void BarnesHut::insertBody(int node, int body, int depth)
+    {
+        if ( nodes[node].firstChild == -1 ) {
+            if ( nodes[node].firstBody == -1 || depth >= MAX_DEPTH ) {
+                bodies[body].next = nodes[node].firstBody;
+                nodes[node].firstBody = body;
+                return;
+            }
+
+            // split the leaf and push its bodies down a level.
+            double half = nodes[node].width / 2;
+            double left = nodes[node].left;
+            double top = nodes[node].top;
+            int first = newNode(left, top, half);
+            newNode(left + half, top, half);
+            newNode(left, top + half, half);
+            newNode(left + half, top + half, half);
+            nodes[node].firstChild = first;
+
+            int chain = nodes[node].firstBody;
+            nodes[node].firstBody = -1;
+            while ( chain != -1 ) {
+                int next = bodies[chain].next;
+                insertBody( first + childFor(nodes[node], bodies[chain]), chain, depth + 1);
+                chain = next;
+            }
+        }
+        insertBody( nodes[node].firstChild + childFor(nodes[node], bodies[body]), body, depth + 1);
+    }
+
+    // fill in the mass, center of mass, and largest radius of each node.
+    void BarnesHut::summarize(int node)
+    {
+        double mass = 0, mx = 0, my = 0, maxRadius = 0;
+        if ( nodes[node].firstChild == -1 ) {
+            for( int body = nodes[node].firstBody; body != -1; body = bodies[body].next ) {
+                const Body& b = bodies[body];
+                mass += b.mass;
+                mx += b.mass * b.x;
+                my += b.mass * b.y;
+                if ( b.radius > maxRadius ) maxRadius = b.radius;
+            }
+        } else {
+            for( int child = nodes[node].firstChild; child < nodes[node].firstChild + 4; child++ ) {
+                summarize(child);
+                const Node& c = nodes[child];
+                mass += c.mass;
+                mx += c.mass * c.x;
+                my += c.mass * c.y;
+                if ( c.maxRadius > maxRadius ) maxRadius = c.maxRadius;
+            }
+        }
+
+        Node& n = nodes[node];
+        n.mass = mass;
+        n.maxRadius = maxRadius;
+        if ( mass > 0 ) {
+            n.x = mx / mass;
+            n.y = my / mass;
+        } else {
+            n.x = n.left + n.width / 2;
+            n.y = n.top + n.width / 2;
+        }
+    }
+
+    Vector2d BarnesHut::force(int body) const
+    {
+        Vector2d total;
+        if ( nodes.empty() ) return total;
+
+        const Body& b = bodies[body];
+        Vector2d position(b.x, b.y);
+
+        // depth first; each level leaves at most three siblings behind.
+        int stack[4 * MAX_DEPTH + 8];
+        int top = 0;
+        stack[top++] = 0;
+        while ( top > 0 ) {
+            const Node& node = nodes[ stack[--top] ];
+            if ( node.mass == 0 ) continue;
+
+            if ( node.firstChild == -1 ) {
+                for( int other = node.firstBody; other != -1; other = bodies[other].next ) {
+                    if ( other == body ) continue;
+                    const Body& o = bodies[other];
+                    double threshold = b.radius > o.radius ? 3 * b.radius : 3 * o.radius;
+                    total += gravity(position, b.mass, Vector2d(o.x, o.y), o.mass, threshold);
+                }
+                continue;
+            }
+
+            // never summarize a node that contains the body itself.
+            bool inside = b.x >= node.left && b.x < node.left + node.width &&
+                          b.y >= node.top && b.y < node.top + node.width;
+            double dx = node.x - b.x;
+            double dy = node.y - b.y;
+            double d = sqrt( dx*dx + dy*dy );
+            if ( !inside && node.width < theta * d ) {
+                double threshold = b.radius > node.maxRadius ? 3 * b.radius : 3 * node.maxRadius;
+                total += gravity(position, b.mass, Vector2d(node.x, node.y), node.mass, threshold);
+            } else {
+                for( int child = node.firstChild + 3; child >= node.firstChild; child-- ) {
+                    stack[top++] = child;
+                }
+            }
+        }
+        return total;
+    }
+
+    Vector2d BarnesHut::exactForce(int body) const
+    {
+        Vector2d total;
+        const Body& b = bodies[body];
+        Vector2d position(b.x, b.y);
+        for( int other = 0; other < int(bodies.size()); other++ ) {
+            if ( other == body ) continue;
+            const Body& o = bodies[other];
+            double threshold = b.radius > o.radius ? 3 * b.radius : 3 * o.radius;
+            total += gravity(position, b.mass, Vector2d(o.x, o.y), o.mass, threshold);
+        }
+        return total;
+    }
+
+} // end namespace PatternSpace
@@ -0,0 +1,81 @@
+/*
+  BarnesHut
+
+  Pairwise gravity is n^2, which is fine for a dozen rocks but hopeless for
+tens of thousands.  BarnesHut builds a quadtree over the bodies each step and
+summarizes every node by its total mass and center of mass.  When a node is
+far enough away, a body feels the whole node as a single point mass instead of
+visiting every body in it.  That brings the cost down to roughly n log n.
+
+  "Far enough" is controlled by the opening angle theta: a node of width s at
+distance d is treated as a point mass when s/d < theta.  Zero means always
+open the node, which gives the same answer as the pairwise sum (up to the
+order of the additions.)  Around .5 is the usual compromise.
+
+  The forces are the same as gravitate() in mass.h, including the gameplay
+clamp that treats anything closer than three radii as exactly three radii
+away.  For a whole node, the clamp uses the largest radius in the node.
+
+Usage:
+  clear() the tree, insert() each body, then build() it.  After that, force()
+returns the total gravitational force on any one of the inserted bodies, and
+exactForce() returns the same thing computed the slow way, which is useful for
+measuring the error of the approximation.
+
+*/
+#ifndef PATTERN_SPACE_GRAVITY_INCLUSION_GUARD
+#define PATTERN_SPACE_GRAVITY_INCLUSION_GUARD
+
+#include <vector>
+
+#include "vector2d.h"
+
+namespace PatternSpace {
+
+/*********************  BarnesHut  *********************/
+    class BarnesHut {
+    public:
+        BarnesHut();
+
+        BarnesHut& openingAngle(double theta);
+        double openingAngle() const;
+
+        BarnesHut& clear();
+        // returns the index of the new body
+        int insert(Vector2d position, double mass, double radius);
+        BarnesHut& build();
+
+        Vector2d force(int body) const;
+        Vector2d exactForce(int body) const;
+
+        int count() const { return int(bodies.size()); }
+
+    private:
+        struct Body {
+            double x, y;
+            double mass;
+            double radius;
+            int next;  // next body in the same leaf, or -1
+        };
+
+        struct Node {
+            double left, top, width;  // bounding square
+            double x, y;              // center of mass
+            double mass;
+            double maxRadius;
+            int firstChild;           // four children in a row, or -1
+            int firstBody;            // bodies in a leaf, or -1
+        };
+
+        int newNode(double left, double top, double width);
+        void insertBody(int node, int body, int depth);
+        void summarize(int node);
+        int childFor(const Node& node, const Body& body) const;
+
+        double theta;
+        std::vector<Body> bodies;
+        std::vector<Node> nodes;
+    }; // end class BarnesHut
+
+} // end namespace PatternSpace
+#endif  // PATTERN_SPACE_GRAVITY_INCLUSION_GUARD
@@ -1,246 +1,791 @@
-/*
-  Implementations for Surface, Image, and Screen
- 
-  BitmpaImage is basically a shared_ptr<Surface>, but it's at the right level 
-of abstraction to cache a set of rotated surfaces.  Plus it implements the
-Image interface.
-
-AnimatedImage also implements the Image interface, cycling through it's
-images regularly.  It's Decorator-ish, in that it delegates to Image and 
-implements the Image interface at the same time.  The difference is it 
-delegates to LIST of Images, instead of decorating just one.
-
-I'll probably add an AgregateImage class that also maintains a list of Images,
-but displays them at the same time, with offsets, to build complex images.
-Of course, AgreateImage could hold AnimatedImages and vice versa; that would
-be handy.
-
-*/
-
-#include "image.h"
-#include <SDL/SDL_rotozoom.h>		// SDL_gfx Rotozoom
-
-namespace PatternSpace {
-
-/*********************  Surface  *********************/
-    
-     // Note: the default constructor is protected, since it
-     // should only be used for derived classes.
-    Surface::Surface():
-        surface(0), count(0)
-    {}
-    
-    Surface::Surface( const char* filename) 
-    {
-        SDL_Surface* rawSurface = SDL_LoadBMP(filename);
-        if ( rawSurface ) {
-            surface = SDL_DisplayFormat(rawSurface);
-            SDL_FreeSurface(rawSurface);
-        }
-        else {
-            surface = 0;
-        }
-        count = 0;
-    }
-    Surface::Surface( SDL_Surface * sdlSurface) 
-    {
-        surface = sdlSurface;
-        count = 0;
-    }
-    
-    Surface::~Surface() {
-        if (surface) {
-            SDL_FreeSurface(surface);
-        }
-    }
-
-    void Surface::blit(Surface& onto, Vector2d location) 
-    {
-        SDL_Rect rectLocation;  // where on the screen to draw, in SDL langauge
-        rectLocation.x = int(location.x());
-        rectLocation.y = int(location.y());
-        // TODO: this needs to be moved to Image
-        Uint32 transparent = SDL_MapRGB(onto.surface->format,0,0,0);
-        SDL_SetColorKey(surface, SDL_SRCCOLORKEY, transparent);       
-        SDL_BlitSurface(surface, 0, onto.surface, &rectLocation);
-    }
-
-    Surface* Surface::rotatedBy(double angle) 
-    {
-        return new Surface( rotozoomSurface(surface, -angle, 1, 1) );
-    }
-    
-    Vector2d Surface::size() {
-        return Vector2d(surface->w,surface->h);
-    }
-
-/*********************  Image  *********************/
-
-    BitmapImage::BitmapImage(const char * filename) 
-    {
-        surface = new Surface(filename);
-        surface->count++;
-    }
-    BitmapImage::BitmapImage(const BitmapImage& other) 
-    {
-        surface = other.surface;
-        surface->count++;
-    }
-    BitmapImage::~BitmapImage() 
-    {
-        surface->count--;
-        if (surface->count == 0) delete surface;
-    }
-    
-    BitmapImage& BitmapImage::operator=(const BitmapImage& other) 
-    {
-        other.surface->count++;
-        surface->count--;
-        if ( surface->count == 0 ) delete surface;
-        surface = other.surface;
-        return *this;
-    }
-    
-    //  Note: in the case of assignment to self, surface and other.surface
-    //  point to the same Surface.  So, we increment then decrement the
-    //  count, leaving it unchanged.  The count won't be zero, so we don't
-    //  free the object.  Finally, copying other.surface to surface doesn't
-    //  change anything, because they already were the same.
-    void BitmapImage::draw(Surface& screen, Vector2d location, double angle) 
-    {
-        if (angle == 0) {
-            surface->blit(screen, location - ( surface->size()/2 ) );
-        } else {
-
-            std::auto_ptr<Surface> rotatedSurface( surface->rotatedBy(angle) );
-            rotatedSurface->blit(screen,location - (rotatedSurface->size()/2) );
-        }
-    }
-    
-    Vector2d BitmapImage::size() 
-    {
-        if ( surface ) {
-            return surface->size();
-        } else {
-            return Vector2d(0,0);
-        }
-    }
-
-/*********************  AnimatedImage  *********************/
-
-    AnimatedImage::AnimatedImage(boost::shared_ptr<Image> pFirstImage, int rate):
-        rate(rate), count(0) 
-    {
-        if (pFirstImage.get()) {
-            images.push_back(pFirstImage);
-        }
-        ppImage = images.begin();
-    }
-    
-    AnimatedImage& AnimatedImage::add(boost::shared_ptr<Image> pImage) 
-    {
-        if (pImage.get() == 0) throw(0);
-        images.push_back(pImage);
-        ppImage = images.begin();
-        count = 0;
-        return *this;
-    }
-    void AnimatedImage::draw(Surface& screen, Vector2d at, double angle) 
-    {
-        if (++count == rate) {
-            count = 0;
-            ppImage++;
-            if ( ppImage == images.end() ) {
-                ppImage = images.begin();
-            }
-        }
-        (*ppImage)->draw(screen, at, angle);
-    }
-
-
-/*********************  Screen  *********************/
-// Note: the exits aren't really appropriate and should be moved up.
-
-    Screen::Screen():
-        _origin(), height(600), width(800) 
-    {
-        
-        if(SDL_Init(SDL_INIT_EVERYTHING) == -1){
-            fprintf(stderr, "Failed to initialize SDL: %s\n", SDL_GetError());
-            exit(1);
-        }
-        // 32 is color depth
-        //surface = SDL_SetVideoMode(width, height, 32, SDL_FULLSCREEN|SDL_HWSURFACE|SDL_DOUBLEBUF);
-        surface = SDL_SetVideoMode(width,height, 32, SDL_HWSURFACE|SDL_DOUBLEBUF);
-        
-    	if(surface == NULL){
-	       fprintf(stderr, "Unable to set video mode: %s\n", SDL_GetError());
-    		exit(1);
-    	}
-    	SDL_ShowCursor(SDL_DISABLE);
-    }
-    
-    void Screen::clear() { SDL_FillRect(surface, NULL, 0); }
-    
-    void Screen::flip() { SDL_Flip(surface); }
-    
-    Screen::~Screen() 
-    {  
-        SDL_Quit(); 
-        // this is really important!  Screen derives from Surface, and 
-        // ~Surface() will attempt to free this SDL surface unless this
-        // pointer is 0.
-        surface = 0;
-                
-        }
-
-    Vector2d Screen::size() 
-    {
-        return Vector2d( double(width), double(height) );
-    }
- 
-    Vector2d Screen::origin() const 
-    {
-        return _origin;
-    }
-    
-    Screen& Screen::origin(const Vector2d& newOrigin) 
-    {
-        _origin = newOrigin;
-    }
-    
-/*********************  SimpleSprite  *********************/
-
-    void SimpleSprite::draw(Screen& screen) 
-    {
-        Vector2d screenPosition = spritePosition() - screen.origin();
-        image().draw(screen, screenPosition, spriteAngle() );
-    }
-  
-/*********************  Background  *********************/
-
-    // tiles the screen with the background image.
-    void Background::draw(Screen& screen) 
-    {
-        double screenWidth = screen.size().x();
-        double screenHeight = screen.size().y();
-        double width = size().x();
-        double height = size().y();
-
-        if (width == 0 or height == 0) return;  // avoid infinite loop
-
-        Vector2d origin = screen.origin();
-        double xbegin = fmod(-origin.x(), width);
-        double ybegin = fmod(-origin.y(), height);
-        if ( xbegin > 0 ) xbegin -= width;
-        if ( ybegin > 0 ) ybegin -= height;
-
-        for( double y = ybegin; y < screenHeight; y += height ) {
-            for( double x = xbegin; x < screenWidth ; x += width) {
-                surface->blit(screen, Vector2d(x, y) );
-            }
-        }
-    }
-        
-} // end namespace PatternSpace
-
+/*
+  Implementations for Surface, Image, and Screen
+ 
+  BitmpaImage is basically a shared_ptr<Surface>, which draws its rotations
+from the RotationCache.  Plus it implements the Image interface.
+
+  The RotationCache is a list of rotations, most recently drawn first, and
+a map from (Surface, step) to its place in the list, so a hit is a lookup
+and a splice to the front.  It's locked, since Surfaces are deleted from
+whichever thread lets go of their last Image, but never while rotating.
+Each rotation remembers which SDL_Surface it was made from, so when the
+ImageStore replace()s a placeholder, its old rotations are simply misses.
+Rotations an Atlas has made ahead of time are kept on the Surface itself,
+and skip the cache altogether.
+
+Surface::blit() copies 32-bit pixels itself, with the SIMD keyedCopy() in
+kernels.h, wherever Raster::copyable() says it can, and leaves anything
+else to SDL_BlitSurface; blitPath(SDL_BLITS) leaves it all to SDL.
+
+A DIRTY_RECTS Screen keeps the rectangles blitted since the last clear().
+clear() merges them, and those are what it clears next frame; flip()
+presents them together with this frame's.  Merging is quadratic, but there
+are only as many rectangles as sprites on the screen.
+
+AnimatedImage also implements the Image interface, cycling through it's
+images regularly.  It's Decorator-ish, in that it delegates to Image and 
+implements the Image interface at the same time.  The difference is it 
+delegates to LIST of Images, instead of decorating just one.
+
+I'll probably add an AgregateImage class that also maintains a list of Images,
+but displays them at the same time, with offsets, to build complex images.
+Of course, AgreateImage could hold AnimatedImages and vice versa; that would
+be handy.
+
+*/
+
+#include <math.h>
+#include <algorithm>
+#include <list>
+#include <map>
+#include <utility>
+
+#include "image.h"
+#include "lock.h"
+#include "raster.h"
+#include "kernels.h"
+#include <SDL/SDL_rotozoom.h>		// SDL_gfx Rotozoom
+
+namespace PatternSpace {
+
+/*********************  Surface  *********************/
+    
+     // Note: the default constructor is protected, since it
+     // should only be used for derived classes.
+    Surface::Surface():
+        surface(0), count(0)
+    {}
+    
+    Surface::Surface( const char* filename) 
+    {
+        surface = load(filename);
+        count = 0;
+    }
+    Surface::Surface( SDL_Surface * sdlSurface) 
+    {
+        surface = sdlSurface;
+        count = 0;
+    }
+    
+    Surface::~Surface() {
+        if (surface) {
+            SDL_FreeSurface(surface);
+        }
+        for( size_t i = 0; i < rotations.size(); i++ ) delete rotations[i];
+    }
+
+    // the BMP in filename in the display format, color keyed, or 0.
+    // This only reads the display format, so it can be done on any thread.
+    SDL_Surface* Surface::load(const char* filename)
+    {
+        SDL_Surface* rawSurface = SDL_LoadBMP(filename);
+        if ( !rawSurface ) return 0;
+        SDL_Surface* loaded = SDL_DisplayFormat(rawSurface);
+        SDL_FreeSurface(rawSurface);
+        keyBlack(loaded);
+        return loaded;
+    }
+
+    SDL_Surface* Surface::current() const
+    {
+        return __atomic_load_n( &surface, __ATOMIC_ACQUIRE );
+    }
+
+    SDL_Surface* Surface::replace(SDL_Surface* sdlSurface)
+    {
+        return __atomic_exchange_n( &surface, sdlSurface, __ATOMIC_ACQ_REL );
+    }
+
+    void Surface::blit(Surface& onto, Vector2d location) 
+    {
+        SDL_Rect rectLocation;  // where on the screen to draw, in SDL langauge
+        rectLocation.x = int(location.x());
+        rectLocation.y = int(location.y());
+        SDL_Surface* source = current();
+        bool drawn = true;
+        if ( onto.queued(source, rectLocation) ) {
+            // drawn at flip()
+        } else if ( blitPath() != SDL_BLITS && Raster::copyable(source, onto.surface) ) {
+            int sourceX, sourceY;
+            if ( Raster::clip(source, rectLocation, onto.surface, sourceX, sourceY) ) {
+                bool locked = SDL_MUSTLOCK(onto.surface) && SDL_LockSurface(onto.surface) == 0;
+                Raster::copy(source, sourceX, sourceY, onto.surface, rectLocation,
+                             rectLocation.y, rectLocation.y + rectLocation.h);
+                if ( locked ) SDL_UnlockSurface(onto.surface);
+            }
+        } else {
+            drawn = SDL_BlitSurface(source, 0, onto.surface, &rectLocation) == 0;
+        }
+        if ( drawn && rectLocation.w && rectLocation.h ) onto.touched(rectLocation);
+    }
+
+    // rotozoomSurface() makes 32 bit RGBA, with per-surface alpha, which
+    // neither Surface::blit() nor the Raster can copy; put it back in the
+    // format it came from.
+    Surface* Surface::rotatedBy(double angle) 
+    {
+        SDL_Surface* source = current();
+        SDL_Surface* rotated = rotozoomSurface(source, -angle, 1, 1);
+        if ( rotated && !Raster::copyable(rotated, source) ) {
+            SDL_Surface* converted = SDL_ConvertSurface(rotated, source->format, SDL_SWSURFACE);
+            if ( converted ) {
+                SDL_FreeSurface(rotated);
+                rotated = converted;
+            }
+        }
+        keyBlack(rotated);
+        return new Surface(rotated);
+    }
+
+    // black is transparent.  Surfaces are blitted over and over without
+    // changing, so RLE encoding them pays for itself when SDL blits them;
+    // but keyedCopy() reads the pixels, so otherwise they're left as they
+    // are, and any encoding they had is taken off.
+    void Surface::keyBlack(SDL_Surface* sdlSurface)
+    {
+        if ( sdlSurface ) {
+            Uint32 flags = blitPath() == SDL_BLITS ? SDL_SRCCOLORKEY|SDL_RLEACCEL : SDL_SRCCOLORKEY;
+            SDL_SetColorKey(sdlSurface, flags, SDL_MapRGB(sdlSurface->format,0,0,0));
+        }
+    }
+    
+    Vector2d Surface::size() {
+        SDL_Surface* sdlSurface = current();
+        return Vector2d(sdlSurface->w,sdlSurface->h);
+    }
+
+/*********************  RotationCache  *********************/
+
+    namespace {
+        struct Rotation {
+            Surface* source;
+            int step;
+            SDL_Surface* from;      // what source held when it was rotated
+            Surface* surface;
+            size_t bytes;
+        };
+        typedef std::list<Rotation> Rotations;     // most recently drawn first
+        typedef std::map< std::pair<Surface*, int>, Rotations::iterator > RotationIndex;
+
+        // never destroyed: the ImageStore lets go of its Surfaces as the
+        // program exits, and they forget() their rotations then, whichever
+        // of the two files' statics is destroyed first.
+        Rotations& rotations = *new Rotations;
+        RotationIndex& rotationIndex = *new RotationIndex;
+        int rotationSteps = 128;
+        size_t rotationBudget = 32 << 20;
+        RotationCache::Stats rotationStats = { 0, 0, 0, 0, 0, 0 };
+        SpinResource& rotationResource = *new SpinResource;
+        bool holding = false;
+        std::vector<Surface*>& held = *new std::vector<Surface*>;     // to free once it's let go
+
+        void dropRotation(RotationIndex::iterator pIndex)
+        {
+            Rotations::iterator pRotation = pIndex->second;
+            rotationStats.bytes -= pRotation->bytes;
+            rotationStats.entries--;
+            if ( holding ) {
+                held.push_back( pRotation->surface );
+            } else {
+                delete pRotation->surface;
+            }
+            rotations.erase(pRotation);
+            rotationIndex.erase(pIndex);
+        }
+
+        // evict from the back until we're within budget, but keep the
+        // front, however big it is; it's about to be drawn.
+        void trimRotations()
+        {
+            if ( holding ) return;
+            while ( rotationStats.bytes > rotationBudget && rotations.size() > 1 ) {
+                const Rotation& last = rotations.back();
+                dropRotation( rotationIndex.find( std::make_pair( last.source, last.step ) ) );
+                rotationStats.evictions++;
+            }
+        }
+
+        void clearRotations()
+        {
+            while ( !rotationIndex.empty() ) dropRotation( rotationIndex.begin() );
+        }
+    }
+
+    Surface& RotationCache::rotated(Surface& source, double angle)
+    {
+        int steps;
+        {
+            Lock lock(rotationResource);
+            steps = rotationSteps;
+        }
+        if ( steps == 0 ) {
+            // uncached; the rotation is kept until the next call instead,
+            // or while held, until it's let go.
+            static std::auto_ptr<Surface> pExact;
+            Surface* pRotated = source.rotatedBy(angle);
+            Lock lock(rotationResource);
+            if ( holding ) {
+                held.push_back(pRotated);
+                return *pRotated;
+            }
+            pExact.reset(pRotated);
+            return *pExact;
+        }
+
+        int step = int( floor( angle * steps / 360 + .5 ) ) % steps;
+        if ( step < 0 ) step += steps;
+        if ( step == 0 ) return source;
+        if ( source.rotations.size() == size_t(steps) && source.rotations[step] ) {
+            __atomic_add_fetch( &rotationStats.packed, 1, __ATOMIC_RELAXED );
+            return *source.rotations[step];
+        }
+        std::pair<Surface*, int> key( &source, step );
+        {
+            Lock lock(rotationResource);
+            RotationIndex::iterator pIndex = rotationIndex.find(key);
+            if ( pIndex != rotationIndex.end() && pIndex->second->from == source.current() ) {
+                rotationStats.hits++;
+                rotations.splice( rotations.begin(), rotations, pIndex->second );
+                return *pIndex->second->surface;
+            }
+            // a rotation of what source held before it was replace()d.
+            if ( pIndex != rotationIndex.end() ) dropRotation(pIndex);
+        }
+
+        Rotation rotation;
+        rotation.source = &source;
+        rotation.step = step;
+        rotation.from = source.current();
+        rotation.surface = source.rotatedBy( step * 360.0 / steps );
+        rotation.bytes = size_t( rotation.surface->surface->pitch ) * rotation.surface->surface->h;
+
+        Lock lock(rotationResource);
+        rotationStats.misses++;
+        rotationStats.bytes += rotation.bytes;
+        rotationStats.entries++;
+        rotations.push_front(rotation);
+        rotationIndex[key] = rotations.begin();
+        trimRotations();
+        return *rotation.surface;
+    }
+
+    void RotationCache::hold(bool state)
+    {
+        Lock lock(rotationResource);
+        holding = state;
+        if ( holding ) return;
+        for( size_t i = 0; i < held.size(); i++ ) delete held[i];
+        held.clear();
+        trimRotations();
+    }
+
+    void RotationCache::forget(Surface& source)
+    {
+        Lock lock(rotationResource);
+        RotationIndex::iterator pIndex = rotationIndex.lower_bound( std::make_pair( &source, 0 ) );
+        while ( pIndex != rotationIndex.end() && pIndex->first.first == &source ) {
+            dropRotation( pIndex++ );
+        }
+    }
+
+    void RotationCache::steps(int count)
+    {
+        Lock lock(rotationResource);
+        if ( count < 0 ) count = 0;
+        if ( count != rotationSteps ) clearRotations();
+        rotationSteps = count;
+    }
+
+    int RotationCache::steps()
+    {
+        Lock lock(rotationResource);
+        return rotationSteps;
+    }
+
+    void RotationCache::budget(size_t bytes)
+    {
+        Lock lock(rotationResource);
+        rotationBudget = bytes;
+        trimRotations();
+    }
+
+    size_t RotationCache::budget()
+    {
+        Lock lock(rotationResource);
+        return rotationBudget;
+    }
+
+    RotationCache::Stats RotationCache::stats()
+    {
+        Lock lock(rotationResource);
+        return rotationStats;
+    }
+
+/*********************  Image  *********************/
+
+    BitmapImage::BitmapImage(const char * filename) 
+    {
+        surface = new Surface(filename);
+        surface->count++;
+    }
+    BitmapImage::BitmapImage(Surface* pSurface) 
+    {
+        surface = pSurface;
+        surface->count++;
+    }
+    // copies are made and let go of on several threads, now that they
+    // share Surfaces from the ImageStore, so the count is atomic.
+    BitmapImage::BitmapImage(const BitmapImage& other) 
+    {
+        surface = other.surface;
+        __atomic_add_fetch( &surface->count, 1, __ATOMIC_RELAXED );
+    }
+    BitmapImage::~BitmapImage() 
+    {
+        if ( __atomic_sub_fetch( &surface->count, 1, __ATOMIC_ACQ_REL ) == 0 ) {
+            RotationCache::forget(*surface);
+            delete surface;
+        }
+    }
+    
+    BitmapImage& BitmapImage::operator=(const BitmapImage& other) 
+    {
+        __atomic_add_fetch( &other.surface->count, 1, __ATOMIC_RELAXED );
+        if ( __atomic_sub_fetch( &surface->count, 1, __ATOMIC_ACQ_REL ) == 0 ) {
+            RotationCache::forget(*surface);
+            delete surface;
+        }
+        surface = other.surface;
+        return *this;
+    }
+    
+    //  Note: in the case of assignment to self, surface and other.surface
+    //  point to the same Surface.  So, we increment then decrement the
+    //  count, leaving it unchanged.  The count won't be zero, so we don't
+    //  free the object.  Finally, copying other.surface to surface doesn't
+    //  change anything, because they already were the same.
+    void BitmapImage::draw(Surface& screen, Vector2d location, double angle) 
+    {
+        if (angle == 0) {
+            surface->blit(screen, location - ( surface->size()/2 ) );
+        } else {
+            Surface& rotatedSurface = RotationCache::rotated(*surface, angle);
+            rotatedSurface.blit(screen,location - (rotatedSurface.size()/2) );
+        }
+    }
+    
+    Vector2d BitmapImage::size() 
+    {
+        if ( surface ) {
+            return surface->size();
+        } else {
+            return Vector2d(0,0);
+        }
+    }
+
+/*********************  AnimatedImage  *********************/
+
+    AnimatedImage::AnimatedImage(boost::shared_ptr<Image> pFirstImage, int rate):
+        rate(rate), count(0) 
+    {
+        if (pFirstImage.get()) {
+            images.push_back(pFirstImage);
+        }
+        ppImage = images.begin();
+    }
+    
+    AnimatedImage& AnimatedImage::add(boost::shared_ptr<Image> pImage) 
+    {
+        if (pImage.get() == 0) throw(0);
+        images.push_back(pImage);
+        ppImage = images.begin();
+        count = 0;
+        return *this;
+    }
+    void AnimatedImage::draw(Surface& screen, Vector2d at, double angle) 
+    {
+        if (++count == rate) {
+            count = 0;
+            ppImage++;
+            if ( ppImage == images.end() ) {
+                ppImage = images.begin();
+            }
+        }
+        (*ppImage)->draw(screen, at, angle);
+    }
+
+    void AnimatedImage::rewind()
+    {
+        ppImage = images.begin();
+        count = 0;
+    }
+
+
+/*********************  Screen  *********************/
+// Note: the exits aren't really appropriate and should be moved up.
+
+    Screen::Screen(Display display, Presentation presentation):
+        _origin(), height(600), width(800), _blend(1), presentation(presentation),
+        whole(true), fresh(true), originX(0), originY(0), holding(false)
+    {
+        counts.frames = counts.full = counts.rects = 0;
+        counts.pixels = 0;
+
+        // SDL's dummy video driver gives us an ordinary surface in memory,
+        // with no window, so everything else works as usual.
+        Uint32 subsystems = SDL_INIT_EVERYTHING;
+        Uint32 flags = SDL_HWSURFACE|SDL_DOUBLEBUF;
+        if ( display == HEADLESS ) {
+            SDL_putenv( const_cast<char*>("SDL_VIDEODRIVER=dummy") );
+            subsystems = SDL_INIT_VIDEO|SDL_INIT_TIMER;
+            flags = SDL_SWSURFACE;
+        }
+        // only updating parts of the screen needs the last frame to still
+        // be there to update, so no double buffering.
+        if ( presentation == DIRTY_RECTS ) flags = SDL_SWSURFACE;
+        
+        if(SDL_Init(subsystems) == -1){
+            fprintf(stderr, "Failed to initialize SDL: %s\n", SDL_GetError());
+            exit(1);
+        }
+        // 32 is color depth
+        //surface = SDL_SetVideoMode(width, height, 32, SDL_FULLSCREEN|SDL_HWSURFACE|SDL_DOUBLEBUF);
+        surface = SDL_SetVideoMode(width,height, 32, flags);
+        
+    	if(surface == NULL){
+	       fprintf(stderr, "Unable to set video mode: %s\n", SDL_GetError());
+    		exit(1);
+    	}
+    	SDL_ShowCursor(SDL_DISABLE);
+    }
+    
+    static int area(const std::vector<SDL_Rect>& rects)
+    {
+        int total = 0;
+        for( size_t i = 0; i < rects.size(); i++ ) total += rects[i].w * rects[i].h;
+        return total;
+    }
+
+    // merge overlapping rectangles until no two overlap.
+    static void merge(std::vector<SDL_Rect>& rects)
+    {
+        bool merged = true;
+        while ( merged ) {
+            merged = false;
+            for( size_t i = 0; i < rects.size(); i++ ) {
+                for( size_t j = i + 1; j < rects.size(); ) {
+                    SDL_Rect& a = rects[i];
+                    const SDL_Rect& b = rects[j];
+                    if ( b.x >= a.x + a.w || a.x >= b.x + b.w || b.y >= a.y + a.h || a.y >= b.y + b.h ) {
+                        j++;
+                        continue;
+                    }
+                    int left = std::min( a.x, b.x ), top = std::min( a.y, b.y );
+                    int right = std::max( a.x + a.w, b.x + b.w ), bottom = std::max( a.y + a.h, b.y + b.h );
+                    a.x = left;
+                    a.y = top;
+                    a.w = right - left;
+                    a.h = bottom - top;
+                    rects[j] = rects.back();
+                    rects.pop_back();
+                    merged = true;
+                }
+            }
+        }
+    }
+
+    // past this fraction of the screen, a frame is cleared and flipped
+    // whole rather than in pieces.
+    static const double MOST_OF_THE_SCREEN = .5;
+
+    void Screen::clear()
+    {
+        int x = int( floor( _origin.x() ) );
+        int y = int( floor( _origin.y() ) );
+        clearedRects.clear();
+        merge(drawn);
+        whole = presentation == FLIP || fresh || x != originX || y != originY
+            || area(drawn) > MOST_OF_THE_SCREEN * width * height;
+        if ( whole ) {
+            SDL_Rect all = { 0, 0, Uint16(width), Uint16(height) };
+            clearedRects.push_back(all);
+        } else {
+            clearedRects.swap(drawn);
+        }
+        for( size_t i = 0; i < clearedRects.size(); i++ ) {
+            SDL_FillRect(surface, &clearedRects[i], 0);
+        }
+        drawn.clear();
+        fresh = false;
+        originX = x;
+        originY = y;
+    }
+    
+    void Screen::flip()
+    {
+        if ( bands.get() ) bands->render(surface);
+        if ( holding ) {
+            RotationCache::hold(false);
+            holding = false;
+        }
+        counts.frames++;
+        if ( !whole ) {
+            updates = clearedRects;
+            updates.insert( updates.end(), drawn.begin(), drawn.end() );
+            merge(updates);
+            int pixels = area(updates);
+            if ( pixels <= MOST_OF_THE_SCREEN * width * height ) {
+                if ( !updates.empty() ) SDL_UpdateRects(surface, int( updates.size() ), &updates[0]);
+                counts.rects += updates.size();
+                counts.pixels += pixels;
+                return;
+            }
+        }
+        SDL_Flip(surface);
+        counts.full++;
+        counts.pixels += (unsigned long long)width * height;
+    }
+
+    Screen& Screen::threads(int count)
+    {
+        if ( count > 1 ) {
+            bands.reset( new Raster(count) );
+        } else {
+            bands.reset();
+        }
+        return *this;
+    }
+
+    int Screen::threads() const
+    {
+        return bands.get() ? bands->threads() : 1;
+    }
+
+    const Raster* Screen::raster() const
+    {
+        return bands.get();
+    }
+
+    bool Screen::queued(SDL_Surface* source, SDL_Rect& at)
+    {
+        if ( !bands.get() ) return false;
+        if ( !holding ) {
+            RotationCache::hold(true);
+            holding = true;
+        }
+        bands->queue(source, at, surface);
+        return true;
+    }
+
+    void Screen::touched(const SDL_Rect& rect)
+    {
+        if ( presentation == DIRTY_RECTS ) drawn.push_back(rect);
+    }
+
+    const std::vector<SDL_Rect>& Screen::cleared() const
+    {
+        return clearedRects;
+    }
+
+    const Screen::Stats& Screen::stats() const
+    {
+        return counts;
+    }
+    
+    Screen::~Screen() 
+    {  
+        bands.reset();
+        SDL_Quit(); 
+        // this is really important!  Screen derives from Surface, and 
+        // ~Surface() will attempt to free this SDL surface unless this
+        // pointer is 0.
+        surface = 0;
+                
+        }
+
+    Vector2d Screen::size() 
+    {
+        return Vector2d( double(width), double(height) );
+    }
+ 
+    Vector2d Screen::origin() const 
+    {
+        return _origin;
+    }
+    
+    Screen& Screen::origin(const Vector2d& newOrigin) 
+    {
+        _origin = newOrigin;
+        return *this;
+    }
+
+    double Screen::blend() const
+    {
+        return _blend;
+    }
+
+    Screen& Screen::blend(double fraction)
+    {
+        _blend = fraction;
+        return *this;
+    }
+    
+/*********************  SimpleSprite  *********************/
+
+    void SimpleSprite::draw(Screen& screen) 
+    {
+        SpriteState state;
+        snapshot(state);
+        state.draw(screen);
+    }
+
+    void SimpleSprite::snapshot(SpriteState& state)
+    {
+        state.image = &image();
+        state.lastPosition = spriteLastPosition();
+        state.position = spritePosition();
+        state.lastAngle = spriteLastAngle();
+        state.angle = spriteAngle();
+        state.radius = spriteRadius();
+    }
+
+/*********************  SpriteState  *********************/
+
+    Vector2d SpriteState::at(double t) const
+    {
+        return lastPosition + ( position - lastPosition ) * t;
+    }
+
+    void SpriteState::draw(Screen& screen) const
+    {
+        double t = screen.blend();
+        double turn = fmod( angle - lastAngle, 360 );
+        if ( turn > 180 ) turn -= 360;
+        if ( turn < -180 ) turn += 360;
+
+        Vector2d screenPosition = at(t) - screen.origin();
+        image->draw(screen, screenPosition, lastAngle + turn * t );
+    }
+  
+/*********************  Background  *********************/
+
+    static int wrap(int a, int n)
+    {
+        return ( a % n + n ) % n;
+    }
+
+    // the Background's own tiles are the bottom layer.
+    Background::Background(const char* filename):
+        BitmapImage(filename)
+    {
+        layers.push_back( Layer(*this, 1) );
+        counts.frames = counts.composed = counts.blits = 0;
+    }
+
+    Background::Background(const BitmapImage& img):
+        BitmapImage(img)
+    {
+        layers.push_back( Layer(*this, 1) );
+        counts.frames = counts.composed = counts.blits = 0;
+    }
+
+    Background& Background::layer(const BitmapImage& image, double depth)
+    {
+        layers.push_back( Layer(image, depth) );
+        return *this;
+    }
+
+    const Background::Stats& Background::stats() const
+    {
+        return counts;
+    }
+
+    // The cache is lined up with the Background's own tiles, and the
+    // Screen's origin falls somewhere in its first tile.  A layer at depth
+    // d is offset by d times the origin, so its tiles are out of step with
+    // the cache's by the difference.  Everything goes at whole pixels, so
+    // that nothing moves until the origin crosses one.
+    void Background::phase(const Layer& layer, int originX, int originY, int& x, int& y)
+    {
+        SDL_Surface* base = surface->current();
+        SDL_Surface* tile = layer.image.surface->current();
+        x = wrap( int( floor( originX * layer.depth ) ) - wrap( originX, base->w ), tile->w );
+        y = wrap( int( floor( originY * layer.depth ) ) - wrap( originY, base->h ), tile->h );
+    }
+
+    void Background::compose(Screen& screen)
+    {
+        SDL_Surface* base = surface->current();
+        int width = int( screen.size().x() ) + base->w;
+        int height = int( screen.size().y() ) + base->h;
+        if ( !cache.get() || cache->surface->w != width || cache->surface->h != height ) {
+            SDL_PixelFormat* format = screen.surface->format;
+            cache.reset( new Surface( SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, format->BitsPerPixel,
+                                      format->Rmask, format->Gmask, format->Bmask, format->Amask) ) );
+        }
+        // not keyed while it's drawn on, or SDL would encode it again after
+        // every tile.
+        SDL_SetColorKey(cache->surface, 0, 0);
+        SDL_FillRect(cache->surface, 0, 0);
+        for( size_t i = 0; i < layers.size(); i++ ) {
+            SDL_Surface* tile = layers[i].image.surface->current();
+            // an ImageStore placeholder; it's left out until it's loaded.
+            if ( tile->w * tile->h <= 1 ) continue;
+            int x0 = -composedAt[2*i], y0 = -composedAt[2*i + 1];
+            for( int y = y0; y < height; y += tile->h ) {
+                for( int x = x0; x < width; x += tile->w ) {
+                    SDL_Rect at;
+                    at.x = x;
+                    at.y = y;
+                    SDL_BlitSurface(tile, 0, cache->surface, &at);
+                }
+            }
+        }
+        // the stars are sparse, and clear() has already blacked out the
+        // screen, so the black needn't be copied.
+        Surface::keyBlack(cache->surface);
+        counts.composed++;
+    }
+
+    // fills whatever the Screen cleared from the cache, composing it first
+    // if it's out of date.  The blits go straight through SDL, so that the
+    // Screen doesn't count them among this frame's.
+    void Background::draw(Screen& screen) 
+    {
+        SDL_Surface* base = surface ? surface->current() : 0;
+        if ( !base || base->w == 0 || base->h == 0 ) return;
+
+        Vector2d origin = screen.origin();
+        int originX = int( floor( origin.x() ) );
+        int originY = int( floor( origin.y() ) );
+
+        bool stale = !cache.get() || composedFrom.size() != layers.size();
+        composedFrom.resize( layers.size() );
+        composedAt.resize( 2 * layers.size() );
+        for( size_t i = 0; i < layers.size(); i++ ) {
+            int x, y;
+            phase( layers[i], originX, originY, x, y );
+            SDL_Surface* from = layers[i].image.surface->current();
+            if ( from != composedFrom[i] || x != composedAt[2*i] || y != composedAt[2*i + 1] ) stale = true;
+            composedFrom[i] = from;
+            composedAt[2*i] = x;
+            composedAt[2*i + 1] = y;
+        }
+        if ( stale ) compose(screen);
+
+        int offsetX = wrap( originX, base->w );
+        int offsetY = wrap( originY, base->h );
+        const std::vector<SDL_Rect>& rects = screen.cleared();
+        for( size_t i = 0; i < rects.size(); i++ ) {
+            SDL_Rect from = rects[i];
+            from.x += offsetX;
+            from.y += offsetY;
+            SDL_Rect to = rects[i];
+            SDL_BlitSurface(cache->surface, &from, screen.surface, &to);
+            counts.blits++;
+        }
+        counts.frames++;
+    }
+        
+} // end namespace PatternSpace
+
@@ -1,156 +1,355 @@
-/*
-   Surface, Image, Screen, and Sprite
-   
-   Surface wraps an SDL_Surface and also contains a reference count.
-   
-   Image contains a Surface, and provides value semantics to images,
-using reference counting to share Surfaces.
-   
-   Screen is a subclass of Surface that mostly handles the initialization
-and cleanup of an SDL context.
-
-  Sprite is the Abstract Base Class for visible objects in PatternSpace.
--------------------------------------------------------------------------
-Usage:
-  Instantiate a Screen before using any SDL functionality.  This sets up
-all the global context behind the scenes.  It is an error to instantiate
-more than one Screen at a time.
-
-  clear() the Screen before drawing each frame, and flip() it when you're
-done drawing.
-
-  Don't use Surfaces directly; instead, create an Image by loading from
-a BMP file.
-
-  Pass the Screen in as the first parameter to draw() to the screen. (You
-can draw on any Surface, though.)  Passing an angle argument to draw()
-will draw the image rotated clockwise by that angle.  
-
-  The current implementation of Image is performance naive, but Image is at the
-correct  level of abstraction to implement a caching scheme for rotated
-images.
-
-SimpleSprite is basically a Mixin: by deriving from SimpleSprite and 
-implementing the virtual methods, you can easily be a Sprite.
-
-Todo: Surface exposes data right now because I wasn't sure what the interface
-should be.  Certainly I don't want to wrap every SDL_ call that takes a 
-SDL_Surface.  Surface is only used within the image module, so it 
-shouldn't be hard to do later.
-
-*/
-#ifndef PATTERN_SPACE_IMAGE_INCLUSION_GUARD
-#define PATTERN_SPACE_IMAGE_INCLUSION_GUARD
-
-#include <boost/shared_ptr.hpp>
-
-#include "vector2d.h"
-#include <SDL/SDL.h>
-#include <stdlib.h>
-#include <memory>
-#include <vector>
-
-namespace PatternSpace {
-
-/*********************  Surface  *********************/
-    class Surface {
-    public:
-        SDL_Surface * surface;
-        int count;
-
-        Surface(const char* filename);
-        Surface(SDL_Surface *);
-        virtual ~Surface();
-        void blit(Surface& onto, Vector2d location);
-        Surface* rotatedBy(double angle);
-        Vector2d size();
-        
-    protected:
-        // Only a subclass should be creating a Surface without
-        // explicitly initializing it somehow.
-        Surface();  
-    }; // end Surface
-
-/*********************  Image  *********************/    
-    class Image {
-    public:
-        virtual ~Image() {}
-        virtual void draw(Surface& screen, Vector2d location, double angle) = 0;
-    }; // end class Image
-    
-    class BitmapImage: public Image {
-    public:    
-        BitmapImage(const char* filename);
-        BitmapImage(const BitmapImage&);
-        ~BitmapImage();
-        BitmapImage& operator=(const BitmapImage& other);
-        
-        void draw(Surface& screen, Vector2d at, double angle);
-        Vector2d size();
-        
-    protected:
-        Surface *surface;
-        
-    }; // end BitmapImage
-
-/*********************  AnimatedImage  *********************/
-    class AnimatedImage: public Image {
-    public:
-        AnimatedImage(boost::shared_ptr<Image> pFirstImage, int rate);
-        ~AnimatedImage() {}
-        AnimatedImage& add(boost::shared_ptr<Image> pImage);
-        void draw(Surface& screen, Vector2d location, double angle);
-
-   protected:
-        std::vector<boost::shared_ptr<Image> > images;
-        std::vector<boost::shared_ptr<Image> >::iterator ppImage;
-        int count;
-        int rate;
-
-    }; // end class AnimatedImage
-
-/*********************  Screen  *********************/    
-    class Screen : public Surface {
-    public:
-        Vector2d origin() const;
-        Screen& origin(const Vector2d& newOrigin);
-        Screen();
-        ~Screen();
-        void clear();
-        void flip();
-        Vector2d size();
-
-    private:
-        int height;
-        int width;
-        Vector2d _origin;        
-    };  // end class Screen
-    
-    // Sprite is an ABC
-    class Sprite {
-    public:
-        virtual void draw(Screen&) = 0;
-        virtual ~Sprite() {}
-    }; // end class Sprite
-    
-    // SimpleSprite uses the Non-Virtual Interface idiom.  The derived class
-    // provides the pure virtual functions, and draw() works in terms of those.
-    class SimpleSprite: public Sprite {
-    protected:
-        virtual double spriteAngle() const = 0;
-        virtual Vector2d spritePosition() const = 0;
-        virtual Image& image() = 0;
-    public:
-        void draw(Screen& );
-    }; // end class SimpleSprite
-
-    class Background: public BitmapImage {
-    public:
-        Background(const char* filename): BitmapImage(filename) {}
-        Background(const BitmapImage& img): BitmapImage(img) {}
-        void draw(Screen&);
-    }; // end class Background
-    
-} // end namespace PatternSpace
-
-#endif // PATTERN_SPACE_IMAGE_INCLUSION_GUARD
+/*
+   Surface, Image, Screen, and Sprite
+   
+   Surface wraps an SDL_Surface and also contains a reference count.  Black
+is transparent; a Surface loaded from a file, or rotated, is color keyed
+once when it's made, rather than every time it's blitted.
+   
+   Image contains a Surface, and provides value semantics to images,
+using reference counting to share Surfaces.
+   
+   Screen is a subclass of Surface that mostly handles the initialization
+and cleanup of an SDL context.
+
+  Sprite is the Abstract Base Class for visible objects in PatternSpace.
+
+  SpriteState is a copy of everything needed to draw a Sprite: which Image,
+and where it was and is.  A Sprite's snapshot() fills one in, and the
+SpriteState can then be drawn later, from another thread, without going back
+to the Sprite.  Only the Image itself is shared, so it has to outlive the
+SpriteState; and since drawing an AnimatedImage advances its animation, an
+Image should only ever be drawn from one thread.
+-------------------------------------------------------------------------
+Usage:
+  Instantiate a Screen before using any SDL functionality.  This sets up
+all the global context behind the scenes.  It is an error to instantiate
+more than one Screen at a time.
+
+  clear() the Screen before drawing each frame, and flip() it when you're
+done drawing.
+
+  A HEADLESS Screen draws into memory through SDL's dummy video driver, and
+never opens a window, so the Universe can be run (and drawn) on a machine
+with no display, e.g. for benchmarking.
+
+  A DIRTY_RECTS Screen only redraws and presents the parts of the screen
+that changed.  Every blit onto it is remembered, and clear() only clears
+where the last frame's blits were, and flip() hands SDL_UpdateRects() just
+those and this frame's, merged where they overlap.  The Background draws
+itself only into what clear() cleared(), so the whole frame has to be
+drawn as usual: clear(), the Background, then everything else.  When the
+origin moves by a whole pixel, every star moves with it, so that frame is
+cleared and flipped in full; so is one where the blits cover too much of
+the screen for the rectangles to be worth it.
+
+  A Screen with more than one of threads() draws its blits all at once, at
+flip(), in bands, one thread to a band (see raster.h).  Until then, the
+RotationCache is held, so that the rotations stay put.
+
+  The Background composes its tiles, once, into a cache a tile bigger
+than the Screen each way, so drawing it is one blit from the cache per
+rectangle cleared.  Parallax layer()s are composed into the same cache.
+A layer that moves at a different depth than the Background slips against
+it as the camera moves, and every time it slips a whole pixel the cache is
+composed again; a still camera, or layers at depth 1, never do.
+
+  The physics runs at its own fixed rate, which is usually slower than the
+frame rate, so a frame generally falls somewhere between two steps.  The
+Screen's blend() says how far, from 0 (the step before last) to 1 (the last
+step), and SimpleSprite draws itself that far between where it was and where
+it is.
+
+  Don't use Surfaces directly; instead, create an Image by loading from
+a BMP file, or better, get one from the ImageStore (see imagestore.h), which
+only loads each file once.
+
+  Pass the Screen in as the first parameter to draw() to the screen. (You
+can draw on any Surface, though.)  Passing an angle argument to draw()
+will draw the image rotated clockwise by that angle.  
+
+  Rotating a Surface is far slower than blitting it, so BitmapImage keeps
+the rotations it has drawn in the RotationCache.  Angles are rounded to one
+of RotationCache::steps() to a full turn, each rotation is only made the
+first time it's drawn, and when the rotations of all the BitmapImages
+together take up more than RotationCache::budget() bytes, the least recently
+drawn are thrown away.  Copies of a BitmapImage share their Surface, and so
+share its rotations too.  Zero steps turns the cache off, and every draw at
+an angle rotates the Surface afresh, exactly.  The cache is shared by every
+thread, but rotated() should only be called from the one that draws.  An
+Atlas (see atlas.h) can make all of an image's rotations ahead of time.
+
+SimpleSprite is basically a Mixin: by deriving from SimpleSprite and 
+implementing the virtual methods, you can easily be a Sprite.
+
+Todo: Surface exposes data right now because I wasn't sure what the interface
+should be.  Certainly I don't want to wrap every SDL_ call that takes a 
+SDL_Surface.  Surface is only used within the image module, so it 
+shouldn't be hard to do later.
+
+*/
+#ifndef PATTERN_SPACE_IMAGE_INCLUSION_GUARD
+#define PATTERN_SPACE_IMAGE_INCLUSION_GUARD
+
+#include <boost/shared_ptr.hpp>
+
+#include "vector2d.h"
+#include <SDL/SDL.h>
+#include <stdlib.h>
+#include <memory>
+#include <vector>
+
+namespace PatternSpace {
+
+    class Raster;
+
+/*********************  Surface  *********************/
+    class Surface {
+    public:
+        SDL_Surface * surface;
+        int count;
+        // made ahead of time by an Atlas, by step (see RotationCache);
+        // rotations[0] is unused.
+        std::vector<Surface*> rotations;
+
+        Surface(const char* filename);
+        Surface(SDL_Surface *);
+        virtual ~Surface();
+        void blit(Surface& onto, Vector2d location);
+        Surface* rotatedBy(double angle);
+        Vector2d size();
+        // The SDL_Surface may be replace()d by another thread while this
+        // one is drawing it, so read it with current().  The old one is
+        // returned, and must outlive anything drawing it.
+        SDL_Surface* current() const;
+        SDL_Surface* replace(SDL_Surface*);
+
+        // a BMP file, ready to blit; see image.cpp.
+        static SDL_Surface* load(const char* filename);
+        // make black transparent, and RLE encode it if blitPath() is
+        // SDL_BLITS.
+        static void keyBlack(SDL_Surface*);
+        
+    protected:
+        // told where each blit onto this Surface landed, after clipping.
+        virtual void touched(const SDL_Rect&) {}
+        // a Surface that draws its blits later takes each source here, with
+        // the rectangle it's to land on, clips that rectangle as
+        // SDL_BlitSurface would, and returns true.
+        virtual bool queued(SDL_Surface*, SDL_Rect&) { return false; }
+
+        // Only a subclass should be creating a Surface without
+        // explicitly initializing it somehow.
+        Surface();  
+    }; // end Surface
+
+/*********************  RotationCache  *********************/
+    class RotationCache {
+    public:
+        struct Stats {
+            unsigned long hits;
+            unsigned long misses;       // rotations made
+            unsigned long evictions;
+            size_t bytes;               // held now
+            size_t entries;
+            unsigned long packed;       // hits on rotations from an Atlas
+        };
+
+        // source rotated clockwise by angle, rounded to the nearest step,
+        // or source itself if that's no turn at all.  The cache owns it,
+        // and it's good until the next call.
+        static Surface& rotated(Surface& source, double angle);
+        // throw away every rotation of source, before it's deleted.
+        static void forget(Surface& source);
+
+        // changing the steps throws everything away.
+        static void steps(int count);
+        static int steps();
+        static void budget(size_t bytes);
+        static size_t budget();
+        static Stats stats();
+        // while held, nothing rotated() has handed out is freed, however far
+        // over budget the cache goes, so that a frame's blits can all be
+        // made after its rotations have all been looked up.
+        static void hold(bool held);
+
+    private:
+        RotationCache();
+    }; // end class RotationCache
+
+/*********************  Image  *********************/    
+    class Image {
+    public:
+        virtual ~Image() {}
+        virtual void draw(Surface& screen, Vector2d location, double angle) = 0;
+        // go back to the first frame, for an Image that has frames.
+        virtual void rewind() {}
+    }; // end class Image
+    
+    class BitmapImage: public Image {
+    public:    
+        BitmapImage(const char* filename);
+        // takes ownership of the Surface.
+        explicit BitmapImage(Surface*);
+        BitmapImage(const BitmapImage&);
+        ~BitmapImage();
+        BitmapImage& operator=(const BitmapImage& other);
+        
+        void draw(Surface& screen, Vector2d at, double angle);
+        Vector2d size();
+        
+    protected:
+        Surface *surface;
+        friend class Background;
+        
+    }; // end BitmapImage
+
+/*********************  AnimatedImage  *********************/
+    class AnimatedImage: public Image {
+    public:
+        AnimatedImage(boost::shared_ptr<Image> pFirstImage, int rate);
+        ~AnimatedImage() {}
+        AnimatedImage& add(boost::shared_ptr<Image> pImage);
+        void draw(Surface& screen, Vector2d location, double angle);
+        void rewind();
+
+   protected:
+        std::vector<boost::shared_ptr<Image> > images;
+        std::vector<boost::shared_ptr<Image> >::iterator ppImage;
+        int count;
+        int rate;
+
+    }; // end class AnimatedImage
+
+/*********************  Screen  *********************/    
+    class Screen : public Surface {
+    public:
+        Vector2d origin() const;
+        Screen& origin(const Vector2d& newOrigin);
+        enum Display { WINDOW, HEADLESS };
+        enum Presentation { FLIP, DIRTY_RECTS };
+        explicit Screen(Display display = WINDOW, Presentation presentation = FLIP);
+        ~Screen();
+        void clear();
+        void flip();
+        Vector2d size();
+        double blend() const;
+        Screen& blend(double fraction);
+        // what the last clear() cleared, for the Background to draw in.
+        const std::vector<SDL_Rect>& cleared() const;
+        // draw the blits in bands, on count threads, at flip(), rather than
+        // on the spot; see raster.h.  One, the default, draws on the spot.
+        Screen& threads(int count);
+        int threads() const;
+        // what's drawing the bands, or 0.
+        const Raster* raster() const;
+
+        // counted over every flip().
+        struct Stats {
+            unsigned long frames;
+            unsigned long full;         // flipped whole
+            unsigned long rects;        // handed to SDL_UpdateRects()
+            unsigned long long pixels;  // presented, including full frames
+        };
+        const Stats& stats() const;
+
+    protected:
+        void touched(const SDL_Rect&);
+        bool queued(SDL_Surface* source, SDL_Rect& at);
+
+    private:
+        int height;
+        int width;
+        Vector2d _origin;        
+        double _blend;
+        Presentation presentation;
+        bool whole;                     // this frame is cleared and flipped whole
+        bool fresh;                     // nothing drawn yet
+        int originX, originY;           // last frame's, in whole pixels
+        std::vector<SDL_Rect> clearedRects;
+        std::vector<SDL_Rect> drawn;    // blits since the last clear()
+        std::vector<SDL_Rect> updates;
+        Stats counts;
+        std::auto_ptr<Raster> bands;
+        bool holding;                   // the RotationCache, until flip()
+    };  // end class Screen
+    
+    // a Sprite, frozen at the end of a step.
+    struct SpriteState {
+        Image* image;
+        Vector2d lastPosition, position;
+        double lastAngle, angle;
+        double radius;          // how far it reaches, for culling
+
+        // where it is, t of the way from the last position to the current one.
+        Vector2d at(double t) const;
+        // draw screen.blend() of the way from the last position to the
+        // current one, and likewise for the angle, turning the short way.
+        void draw(Screen&) const;
+    };
+
+    // Sprite is an ABC
+    class Sprite {
+    public:
+        virtual void draw(Screen&) = 0;
+        virtual void snapshot(SpriteState&) = 0;
+        virtual ~Sprite() {}
+    }; // end class Sprite
+    
+    // SimpleSprite uses the Non-Virtual Interface idiom.  The derived class
+    // provides the pure virtual functions, and draw() and snapshot() work in
+    // terms of those.
+    class SimpleSprite: public Sprite {
+    protected:
+        virtual double spriteAngle() const = 0;
+        virtual Vector2d spritePosition() const = 0;
+        virtual Image& image() = 0;
+        // where the sprite was one step ago; by default, where it is now.
+        virtual double spriteLastAngle() const { return spriteAngle(); }
+        virtual Vector2d spriteLastPosition() const { return spritePosition(); }
+        // how far the sprite reaches from its position; by default, nowhere.
+        virtual double spriteRadius() const { return 0; }
+    public:
+        void draw(Screen& );
+        void snapshot(SpriteState& );
+    }; // end class SimpleSprite
+
+    class Background: public BitmapImage {
+    public:
+        Background(const char* filename);
+        Background(const BitmapImage& img);
+        // another layer, tiled over the ones before, which moves depth
+        // times as far as the camera: less than 1 is further away.
+        Background& layer(const BitmapImage& image, double depth);
+        // fills what the Screen last cleared().
+        void draw(Screen&);
+
+        // counted over every draw().
+        struct Stats {
+            unsigned long frames;
+            unsigned long composed;     // frames that had to compose the cache
+            unsigned long blits;        // onto the Screen
+        };
+        const Stats& stats() const;
+
+    private:
+        struct Layer {
+            Layer(const BitmapImage& image, double depth): image(image), depth(depth) {}
+            BitmapImage image;
+            double depth;
+        };
+        // where layer's tiles start, in the cache, for origin.
+        void phase(const Layer& layer, int originX, int originY, int& x, int& y);
+        void compose(Screen& screen);
+
+        std::vector<Layer> layers;
+        std::auto_ptr<Surface> cache;
+        // what the cache was composed from: each layer's SDL_Surface and
+        // phase.
+        std::vector<SDL_Surface*> composedFrom;
+        std::vector<int> composedAt;
+        Stats counts;
+    }; // end class Background
+    
+} // end namespace PatternSpace
+
+#endif // PATTERN_SPACE_IMAGE_INCLUSION_GUARD
@@ -0,0 +1,235 @@
+/*
+  Implementation for ImageStore
+
+  The images are kept in a map by filename.  Without the loader, the lock is
+held while a file is loaded, so two threads asking for the same new file
+don't both load it; it's a FutexResource (where there is one) rather than a
+SpinResource, since a load takes long enough that anyone waiting ought to
+sleep.
+
+  The loader takes filenames from the front of a queue, and is woken by a
+semaphore that's posted once per filename, and once more to stop it.  It
+loads without the lock, then replace()s the placeholder's SDL_Surface with
+the loaded one.  The painter may be in the middle of blitting the
+placeholder just then, so it isn't freed until the program exits; there's
+one single pixel of them per file loaded in the background.
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <SDL/SDL_thread.h>
+
+#include "imagestore.h"
+#include "lock.h"
+
+namespace PatternSpace {
+
+/*********************  ImageStore  *********************/
+
+    namespace {
+        struct StoredImage {
+            StoredImage(): surface(0), ready(false) {}
+            boost::shared_ptr<BitmapImage> pImage;
+            Surface* surface;       // pImage's
+            bool ready;
+        };
+        typedef std::map<std::string, StoredImage> StoredImages;
+
+        // placeholders that have been replaced.
+        struct Retired {
+            std::vector<SDL_Surface*> surfaces;
+            ~Retired()
+            {
+                for( size_t i = 0; i < surfaces.size(); i++ ) SDL_FreeSurface( surfaces[i] );
+            }
+        };
+
+        StoredImages storedImages;
+        std::deque<std::string> queued;
+        Retired retired;
+        ImageStore::Stats storeStats = { 0, 0, 0, 0, 0, 0 };
+        SDL_Thread* loaderThread = 0;
+        bool stopping = false;
+
+        Resource& storeResource()
+        {
+            static std::auto_ptr<Resource> pResource( newResource(FUTEX) );
+            return *pResource;
+        }
+
+        SemaphoreResource& wakeResource()
+        {
+            static SemaphoreResource wake(0);
+            return wake;
+        }
+
+        SDL_Surface* newPlaceholder()
+        {
+            SDL_Surface* placeholder = SDL_CreateRGBSurface( SDL_SWSURFACE, 1, 1, 32, 0, 0, 0, 0 );
+            SDL_FillRect( placeholder, 0, 0 );
+            Surface::keyBlack(placeholder);
+            return placeholder;
+        }
+    }
+
+    boost::shared_ptr<BitmapImage> ImageStore::stored(const char* filename, bool counted)
+    {
+        Lock lock( storeResource() );
+        if ( counted ) storeStats.requests++;
+        StoredImage& stored = storedImages[filename];
+        if ( !stored.pImage ) {
+            if ( loaderThread ) {
+                stored.surface = new Surface( newPlaceholder() );
+                stored.pImage.reset( new BitmapImage(stored.surface) );
+                queued.push_back(filename);
+                storeStats.pending++;
+                wakeResource().post();
+            } else {
+                stored.surface = new Surface(filename);
+                stored.pImage.reset( new BitmapImage(stored.surface) );
+                stored.ready = true;
+                storeStats.loads++;
+                if ( !stored.surface->current() ) storeStats.failures++;
+            }
+            storeStats.images = storedImages.size();
+        }
+        if ( counted && !stored.ready ) storeStats.placeholders++;
+        return stored.pImage;
+    }
+
+    BitmapImage ImageStore::bitmap(const char* filename)
+    {
+        return *stored(filename, true);
+    }
+
+    boost::shared_ptr<Image> ImageStore::image(const char* filename)
+    {
+        return stored(filename, true);
+    }
+
+    BitmapImage ImageStore::prefetch(const char* filename)
+    {
+        return *stored(filename, false);
+    }
+
+    bool ImageStore::warm(const char* manifest)
+    {
+        FILE* in = fopen( manifest, "r" );
+        if ( !in ) return false;
+        char line[1024];
+        while ( fgets( line, sizeof(line), in ) ) {
+            size_t length = strcspn( line, "\r\n" );
+            line[length] = 0;
+            if ( length == 0 || line[0] == '#' ) continue;
+            prefetch(line);
+        }
+        fclose(in);
+        return true;
+    }
+
+    bool ImageStore::ready(const char* filename)
+    {
+        Lock lock( storeResource() );
+        StoredImages::const_iterator pStored = storedImages.find(filename);
+        return pStored != storedImages.end() && pStored->second.ready;
+    }
+
+    void ImageStore::pack()
+    {
+        Lock lock( storeResource() );
+        std::vector<Surface*> surfaces;
+        for( StoredImages::iterator pStored = storedImages.begin(); pStored != storedImages.end(); pStored++ ) {
+            if ( pStored->second.ready ) surfaces.push_back( pStored->second.surface );
+        }
+        atlas().pack( surfaces, RotationCache::steps() );
+    }
+
+    void ImageStore::rekey()
+    {
+        Lock lock( storeResource() );
+        for( StoredImages::iterator pStored = storedImages.begin(); pStored != storedImages.end(); pStored++ ) {
+            if ( !pStored->second.ready ) continue;
+            Surface* surface = pStored->second.surface;
+            Surface::keyBlack( surface->current() );
+            for( size_t step = 1; step < surface->rotations.size(); step++ ) {
+                if ( surface->rotations[step] ) Surface::keyBlack( surface->rotations[step]->current() );
+            }
+        }
+    }
+
+    Atlas& ImageStore::atlas()
+    {
+        static Atlas storeAtlas;
+        return storeAtlas;
+    }
+
+    int ImageStore::loader(void*)
+    {
+        for(;;) {
+            wakeResource().wait();
+            std::string filename;
+            {
+                Lock lock( storeResource() );
+                if ( queued.empty() ) {
+                    if ( stopping ) return 0;
+                    continue;
+                }
+                filename = queued.front();
+                queued.pop_front();
+            }
+
+            SDL_Surface* loaded = Surface::load( filename.c_str() );
+
+            Lock lock( storeResource() );
+            StoredImage& stored = storedImages[filename];
+            if ( loaded ) {
+                retired.surfaces.push_back( stored.surface->replace(loaded) );
+            } else {
+                storeStats.failures++;
+            }
+            stored.ready = true;
+            storeStats.loads++;
+            storeStats.pending--;
+        }
+    }
+
+    void ImageStore::background(bool state)
+    {
+        if ( state == background() ) return;
+        if ( state ) {
+            Lock lock( storeResource() );
+            stopping = false;
+            loaderThread = SDL_CreateThread( loader, 0 );
+        } else {
+            // the loader finishes the queue before it sees this.
+            {
+                Lock lock( storeResource() );
+                stopping = true;
+            }
+            wakeResource().post();
+            SDL_WaitThread( loaderThread, 0 );
+            Lock lock( storeResource() );
+            loaderThread = 0;
+        }
+    }
+
+    bool ImageStore::background()
+    {
+        Lock lock( storeResource() );
+        return loaderThread != 0;
+    }
+
+    ImageStore::Stats ImageStore::stats()
+    {
+        Lock lock( storeResource() );
+        return storeStats;
+    }
+
+} // end namespace PatternSpace
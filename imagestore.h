@@ -0,0 +1,92 @@
+/*
+  ImageStore
+
+  Every image the game draws comes from a handful of BMP files, but the
+factories used to load a fresh copy from disk for every Solid they made,
+and seven for every explosion.  The ImageStore loads each file once, the
+first time it's asked for, converts it to the display format, and sets its
+color key (black is transparent) with Surface::keyBlack(), which RLE
+encodes it when SDL does the blitting, so blitting it needs no more
+setting up.  After that, everyone who asks for the same file shares
+the same Surface, and with it the same rotations in the RotationCache.
+
+  The Surfaces are kept until the program exits, since there are only a few
+dozen of them and any of them may be wanted again at any moment.
+
+  Loading can also be done in the background, by a loader thread, so that
+neither starting up nor the first of anything being spawned has to wait for
+the disk.  While the loader is running, asking for a file that isn't loaded
+yet never waits: it's queued for the loader, and the image handed out is a
+placeholder (a single transparent pixel, so nothing is drawn) whose Surface
+is filled in as soon as the file is loaded.  Every copy of the image shares
+that Surface, so each one turns into the real thing at the same moment,
+wherever it has got to; the image is its own future.
+
+Usage:
+  bitmap() gives a BitmapImage of its own, for a Solid to own; image()
+gives the stored one itself, for sharing between AnimatedImages, whose
+frames are shared_ptrs.  Either way the Surface is shared.  The Screen must
+already be there, since loading converts to its format.  The store is
+locked, so any thread may ask.
+
+  background(true) starts the loader thread, and background(false) waits
+for it to load everything queued and stops it; stop it before the Screen
+goes.  prefetch() queues a file, and warm() queues every file listed in a
+manifest, one per line (blank lines and lines starting with # are skipped),
+e.g. while a title screen is up.  ready() says whether a file is loaded.
+With the loader stopped, all of these load on the spot.
+
+  pack() moves every image loaded so far into the store's Atlas, along with
+all its rotations at the RotationCache's steps(); nothing may be drawing
+meanwhile, so do it once loading is done, before the painter starts.
+rekey() keys them all again, with their Atlas rotations, after a change of
+blitPath(), again while nothing is drawing.
+
+*/
+#ifndef PATTERN_SPACE_IMAGE_STORE_INCLUSION_GUARD
+#define PATTERN_SPACE_IMAGE_STORE_INCLUSION_GUARD
+
+#include <boost/shared_ptr.hpp>
+
+#include "image.h"
+#include "atlas.h"
+
+namespace PatternSpace {
+
+/*********************  ImageStore  *********************/
+    class ImageStore {
+    public:
+        struct Stats {
+            unsigned long requests;     // not counting prefetches
+            unsigned long loads;        // files read, here or in the background
+            unsigned long placeholders; // requests answered before the file was loaded
+            unsigned long failures;     // files that couldn't be read
+            size_t images;
+            size_t pending;             // queued for the loader, or being loaded
+        };
+
+        static BitmapImage bitmap(const char* filename);
+        static boost::shared_ptr<Image> image(const char* filename);
+
+        static void background(bool state);
+        static bool background();
+        static BitmapImage prefetch(const char* filename);
+        // false if the manifest couldn't be read.
+        static bool warm(const char* manifest);
+        static bool ready(const char* filename);
+
+        static void pack();
+        static void rekey();
+        static Atlas& atlas();
+
+        static Stats stats();
+
+    private:
+        // counted in requests and placeholders, unless it's a prefetch.
+        static boost::shared_ptr<BitmapImage> stored(const char* filename, bool counted);
+        static int loader(void*);
+        ImageStore();
+    }; // end class ImageStore
+
+} // end namespace PatternSpace
+#endif  // PATTERN_SPACE_IMAGE_STORE_INCLUSION_GUARD
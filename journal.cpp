@@ -0,0 +1,159 @@
+/*
+  Implementation for Journal
+
+  Numbers are written with %.17g, so that a position read back is exactly
+the position written, and the replay starts from exactly the same place.
+
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include "journal.h"
+#include "factories.h"
+
+namespace PatternSpace {
+
+/*********************  Journal  *********************/
+    Journal::Journal():
+        stepLength(0), steps(0), digest(0), hasDigest(false), nextEvent(0)
+    {}
+
+    Journal& Journal::place(const char* kind, Vector2d position, Vector2d velocity)
+    {
+        Placement placement;
+        placement.kind = kind;
+        placement.position = position;
+        placement.velocity = velocity;
+        scene.push_back(placement);
+        return *this;
+    }
+
+    SolidHandle Journal::populate(Universe& universe, std::vector<SolidHandle>* handles) const
+    {
+        std::vector< boost::shared_ptr<Solid> > solids;
+        solids.reserve( scene.size() );
+        size_t ship = scene.size();
+        std::vector<Placement>::const_iterator pPlacement;
+        for( pPlacement = scene.begin(); pPlacement != scene.end(); pPlacement++ ) {
+            const std::string& kind = pPlacement->kind;
+            Vector2d p = pPlacement->position;
+            Vector2d v = pPlacement->velocity;
+            if ( kind == "rock" ) {
+                solids.push_back( newRock(p, v) );
+            } else if ( kind == "bigrock" ) {
+                solids.push_back( newBigRock(p, v) );
+            } else if ( kind == "alien" ) {
+                solids.push_back( newAlien(p, v) );
+            } else if ( kind == "explosion" ) {
+                solids.push_back( newExplosion(p, v) );
+            } else if ( kind == "missle" ) {
+                solids.push_back( newMissle(p, v) );
+            } else if ( kind == "ship" ) {
+                if ( ship == scene.size() ) ship = solids.size();
+                solids.push_back( newShip(p, v) );
+            }
+        }
+
+        std::vector<SolidHandle> added;
+        universe.add( solids, &added );
+        if ( handles ) handles->insert( handles->end(), added.begin(), added.end() );
+        return ship < added.size() ? added[ship] : SolidHandle();
+    }
+
+    Journal& Journal::record(unsigned long step, Control control, bool state)
+    {
+        Event event;
+        event.step = step;
+        event.control = control;
+        event.state = state;
+        events.push_back(event);
+        return *this;
+    }
+
+    Journal& Journal::replay(unsigned long step, Controls& controls)
+    {
+        if ( step == 0 ) nextEvent = 0;
+        while ( nextEvent < events.size() && events[nextEvent].step <= step ) {
+            const Event& event = events[nextEvent++];
+            switch ( event.control ) {
+                case UP:      controls.up(event.state); break;
+                case DOWN:    controls.down(event.state); break;
+                case LEFT:    controls.left(event.state); break;
+                case RIGHT:   controls.right(event.state); break;
+                case PRIMARY: controls.primary(event.state); break;
+                default: break;
+            }
+        }
+        return *this;
+    }
+
+    const char* Journal::controlName(Control control)
+    {
+        static const char* names[CONTROLS] = { "up", "down", "left", "right", "primary" };
+        return control < CONTROLS ? names[control] : "unknown";
+    }
+
+    bool Journal::write(const char* filename) const
+    {
+        FILE* file = fopen( filename, "w" );
+        if ( !file ) return false;
+        fprintf( file, "step-ms %.17g\n", stepLength );
+        std::vector<Placement>::const_iterator pPlacement;
+        for( pPlacement = scene.begin(); pPlacement != scene.end(); pPlacement++ ) {
+            fprintf( file, "place %s %.17g %.17g %.17g %.17g\n", pPlacement->kind.c_str(),
+                     pPlacement->position.x(), pPlacement->position.y(),
+                     pPlacement->velocity.x(), pPlacement->velocity.y() );
+        }
+        std::vector<Event>::const_iterator pEvent;
+        for( pEvent = events.begin(); pEvent != events.end(); pEvent++ ) {
+            fprintf( file, "control %lu %s %d\n", pEvent->step, controlName(pEvent->control), pEvent->state ? 1 : 0 );
+        }
+        fprintf( file, "steps %lu\n", steps );
+        if ( hasDigest ) fprintf( file, "digest %016llx\n", digest );
+        return fclose(file) == 0;
+    }
+
+    bool Journal::read(const char* filename)
+    {
+        FILE* file = fopen( filename, "r" );
+        if ( !file ) return false;
+        scene.clear();
+        events.clear();
+        nextEvent = 0;
+        steps = 0;
+        hasDigest = false;
+
+        bool ok = true;
+        char line[256];
+        while ( ok && fgets( line, sizeof(line), file ) ) {
+            char word[32];
+            if ( sscanf( line, "%31s", word ) != 1 ) continue;   // blank line
+            if ( strcmp( word, "step-ms" ) == 0 ) {
+                ok = sscanf( line, "%*s %lf", &stepLength ) == 1;
+            } else if ( strcmp( word, "place" ) == 0 ) {
+                char kind[32];
+                double x, y, vx, vy;
+                ok = sscanf( line, "%*s %31s %lf %lf %lf %lf", kind, &x, &y, &vx, &vy ) == 5;
+                if ( ok ) place( kind, Vector2d(x, y), Vector2d(vx, vy) );
+            } else if ( strcmp( word, "control" ) == 0 ) {
+                unsigned long step;
+                char name[32];
+                int state;
+                ok = sscanf( line, "%*s %lu %31s %d", &step, name, &state ) == 3;
+                int control = 0;
+                while ( control < CONTROLS && strcmp( name, controlName( Control(control) ) ) != 0 ) control++;
+                ok = ok && control < CONTROLS;
+                if ( ok ) record( step, Control(control), state != 0 );
+            } else if ( strcmp( word, "steps" ) == 0 ) {
+                ok = sscanf( line, "%*s %lu", &steps ) == 1;
+            } else if ( strcmp( word, "digest" ) == 0 ) {
+                ok = hasDigest = sscanf( line, "%*s %llx", &digest ) == 1;
+            } else if ( word[0] != '#' ) {
+                ok = false;
+            }
+        }
+        fclose(file);
+        return ok && stepLength > 0;
+    }
+
+} // end namespace PatternSpace
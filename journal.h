@@ -0,0 +1,126 @@
+/*
+  Journal, RecordingControls
+
+  A Journal is a record of one run of the game: the Solids it started with,
+and every call made on the Ship's Controls, with the step it was made before.
+Since the physics runs in fixed steps, and only ever sees the Controls
+between steps, that's all it takes to run exactly the same game again, as
+fast as the machine will go.  That makes for repeatable workloads to profile
+and benchmark, and, with the Universe's digest() at the end, a check that a
+faster code path still flies the same trajectories.
+
+  RecordingControls is a Decorator: it passes every call on to the real
+Controls, and writes it into a Journal as well.
+
+  The file is plain text, one entry per line:
+
+    step-ms 16.6667                 the length of a step
+    place rock -400 100 -0.2 0.1    a Solid: factory, position, velocity
+    control 120 up 1                before step 120, up(true)
+    steps 3600                      how many steps the run took
+    digest 9b2069edeb368e57         Universe::digest() at the end
+
+  The kinds of Solid are those in factories.h: rock, bigrock, alien,
+explosion, missle and ship.  The first ship placed is the one the Controls
+belong to.
+
+Usage:
+  To record, place() the scene and populate() the Universe from it, wrap the
+Ship in a RecordingControls, tell it which step is next with at() as the
+game goes, and write() the Journal at the end.  To replay, read() it,
+populate() a new Universe, and before each step, replay() that step's
+Controls calls into the Ship.
+
+  Since the ship can die, hold on to its SolidHandle rather than the Ship,
+and look it up with Universe::find() each step.
+
+  A replay only comes out the same with the same collision and gravity modes
+(swept or not) and kernels; with more than one thread, any number of threads
+will do.
+
+*/
+#ifndef PATTERN_SPACE_JOURNAL_INCLUSION_GUARD
+#define PATTERN_SPACE_JOURNAL_INCLUSION_GUARD
+
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include "vector2d.h"
+#include "ship.h"
+#include "universe.h"
+
+namespace PatternSpace {
+
+/*********************  Journal  *********************/
+    class Journal {
+    public:
+        enum Control { UP, DOWN, LEFT, RIGHT, PRIMARY, CONTROLS };
+
+        struct Placement {
+            std::string kind;
+            Vector2d position, velocity;
+        };
+        struct Event {
+            unsigned long step;     // made just before this step
+            Control control;
+            bool state;
+        };
+
+        Journal();
+
+        // start with another Solid.
+        Journal& place(const char* kind, Vector2d position, Vector2d velocity);
+        // add everything placed to the Universe, and return the first
+        // ship's handle, which is stale if there wasn't one.  The handles
+        // of the Solids added, in the order placed, go in handles.
+        SolidHandle populate(Universe& universe, std::vector<SolidHandle>* handles = 0) const;
+        int placed() const { return int(scene.size()); }
+
+        Journal& record(unsigned long step, Control control, bool state);
+        // make the calls recorded before the given step.  Call it for every
+        // step, in order, starting from zero.
+        Journal& replay(unsigned long step, Controls& controls);
+
+        // false if the file couldn't be opened, or didn't make sense.
+        bool read(const char* filename);
+        bool write(const char* filename) const;
+
+        static const char* controlName(Control control);
+
+        double stepLength;
+        unsigned long steps;
+        unsigned long long digest;
+        bool hasDigest;
+
+    private:
+        std::vector<Placement> scene;
+        std::vector<Event> events;
+        size_t nextEvent;           // for replay()
+    }; // end class Journal
+
+/*********************  RecordingControls  *********************/
+    class RecordingControls: public Controls {
+    public:
+        RecordingControls(Controls& controls, Journal& journal):
+            controls(controls), journal(journal), step(0) {}
+
+        // the calls that follow are made before this step.
+        void at(unsigned long nextStep) { step = nextStep; }
+
+        void up(bool state)      { pass( Journal::UP, state ); controls.up(state); }
+        void down(bool state)    { pass( Journal::DOWN, state ); controls.down(state); }
+        void left(bool state)    { pass( Journal::LEFT, state ); controls.left(state); }
+        void right(bool state)   { pass( Journal::RIGHT, state ); controls.right(state); }
+        void primary(bool state) { pass( Journal::PRIMARY, state ); controls.primary(state); }
+
+    private:
+        void pass(Journal::Control control, bool state) { journal.record( step, control, state ); }
+
+        Controls& controls;
+        Journal& journal;
+        unsigned long step;
+    }; // end class RecordingControls
+
+} // end namespace PatternSpace
+#endif  // PATTERN_SPACE_JOURNAL_INCLUSION_GUARD
@@ -0,0 +1,463 @@
+/*
+  Implementation for the Batch Kernels
+
+  The AVX2 functions are compiled with a per-function target attribute, so
+the rest of the program doesn't need -mavx2 and still runs on older CPUs.
+That needs GCC 4.9 or later on x86; everything else gets the scalar path.
+
+  The scalar path is written out with doubles rather than Vector2d, but the
+operations are the ones gravity() and collision() use, in the same order.
+
+  The SSE2 blit is compiled with a target attribute too, for 32-bit x86;
+on x86-64 it's there anyway.  The vector blits load the destination and
+blend, so they write back the keyed pixels unchanged; that's only safe
+because nothing else writes to the row at the same time (see raster.h).
+
+*/
+#include <cmath>
+
+#include "kernels.h"
+#include "mass.h"
+
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) \
+    && (defined(__x86_64__) || defined(__i386__))
+#define PATTERN_SPACE_AVX2_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace PatternSpace {
+
+/*********************  Scalar Kernels  *********************/
+    // the force between body i and bodies from..to-1 of the second set,
+    // added to (fx1, fy1) for body i and taken from fx2, fy2.
+    static void rowGravityScalar( double x1, double y1, double mass1, double radius1,
+                                  int from, int to, const double* x, const double* y,
+                                  const double* mass, const double* radius,
+                                  double& fx1, double& fy1, double* fx2, double* fy2)
+    {
+        Vector2d position1( x1, y1 );
+        for( int j = from; j < to; j++ ) {
+            double threshold = radius1 > radius[j] ? 3*radius1 : 3*radius[j];
+            Vector2d F = gravity( position1, mass1, Vector2d( x[j], y[j] ), mass[j], threshold );
+            fx1 += F.x();
+            fy1 += F.y();
+            fx2[j] -= F.x();
+            fy2[j] -= F.y();
+        }
+    }
+
+    static void pairwiseGravityScalar( int n, const double* x, const double* y,
+                                       const double* mass, const double* radius,
+                                       double* fx, double* fy)
+    {
+        for( int i = 0; i < n; i++ ) {
+            rowGravityScalar( x[i], y[i], mass[i], radius[i], i + 1, n, x, y, mass, radius,
+                              fx[i], fy[i], fx, fy );
+        }
+    }
+
+    static void crossGravityScalar( int n1, const double* x1, const double* y1,
+                                    const double* mass1, const double* radius1,
+                                    int n2, const double* x2, const double* y2,
+                                    const double* mass2, const double* radius2,
+                                    double* fx1, double* fy1, double* fx2, double* fy2)
+    {
+        for( int i = 0; i < n1; i++ ) {
+            rowGravityScalar( x1[i], y1[i], mass1[i], radius1[i], 0, n2, x2, y2, mass2, radius2,
+                              fx1[i], fy1[i], fx2, fy2 );
+        }
+    }
+
+    static int collisionContactsScalar( int count, const std::pair<int,int>* candidates,
+                                        const double* x, const double* y,
+                                        const double* vx, const double* vy,
+                                        const double* mass, const double* radius,
+                                        double travel, Contact* contacts)
+    {
+        int found = 0;
+        for( int k = 0; k < count; k++ ) {
+            int i = candidates[k].first;
+            int j = candidates[k].second;
+            double Rx = x[j] - x[i];
+            double Ry = y[j] - y[i];
+            double r = sqrt( Rx*Rx + Ry*Ry );
+            double reach = radius[i] + radius[j];
+            double overlap = reach - r;
+            double impact = 0;
+            if ( overlap < 0 ) {
+                if ( travel == 0 ) continue;
+                double Vx = ( vx[j] - vx[i] ) * travel;
+                double Vy = ( vy[j] - vy[i] ) * travel;
+                double t = timeOfImpact( Rx, Ry, Vx, Vy, reach );
+                if ( t > 1 ) continue;
+                impact = t * travel;
+                Rx = Rx + Vx * t;
+                Ry = Ry + Vy * t;
+                r = sqrt( Rx*Rx + Ry*Ry );
+                overlap = 0;
+            }
+            double axisX = 0, axisY = 0;
+            if ( r > 0 ) {
+                axisX = Rx/r;
+                axisY = Ry/r;
+            }
+            double p1 = ( vx[i]*axisX + vy[i]*axisY ) * mass[i];
+            double p2 = ( vx[j]*axisX + vy[j]*axisY ) * mass[j];
+            double vc = ( p1 + p2 ) / ( mass[i] + mass[j] );
+
+            Contact& contact = contacts[found++];
+            contact.pair = k;
+            contact.axisX = axisX;
+            contact.axisY = axisY;
+            contact.overlap = overlap;
+            contact.impulse = 2*( p1 - vc * mass[i] );
+            contact.impact = impact;
+        }
+        return found;
+    }
+
+    static void keyedCopyScalar( int count, const unsigned* from, unsigned* to, unsigned key, unsigned mask )
+    {
+        for( int i = 0; i < count; i++ ) {
+            if ( ( from[i] & mask ) != key ) to[i] = from[i];
+        }
+    }
+
+/*********************  AVX2 Kernels  *********************/
+#ifdef PATTERN_SPACE_AVX2_KERNELS
+    __attribute__((target("avx2")))
+    static double sum( __m256d v )
+    {
+        double lanes[4];
+        _mm256_storeu_pd( lanes, v );
+        return ( lanes[0] + lanes[1] ) + ( lanes[2] + lanes[3] );
+    }
+
+    // rowGravityScalar(), four bodies of the second set at a time; the
+    // leftovers go through the scalar version.
+    __attribute__((target("avx2")))
+    static void rowGravityAVX2( double x1, double y1, double mass1, double radius1,
+                                int from, int to, const double* x, const double* y,
+                                const double* mass, const double* radius,
+                                double& fx1, double& fy1, double* fx2, double* fy2)
+    {
+        const __m256d zero = _mm256_setzero_pd();
+        const __m256d three = _mm256_set1_pd(3);
+        __m256d xi = _mm256_set1_pd( x1 );
+        __m256d yi = _mm256_set1_pd( y1 );
+        __m256d ri = _mm256_set1_pd( radius1 );
+        __m256d Gmi = _mm256_set1_pd( G * mass1 );
+        __m256d sumX = zero, sumY = zero;
+        int j = from;
+        for( ; j + 4 <= to; j += 4 ) {
+            __m256d Rx = _mm256_sub_pd( _mm256_loadu_pd( x + j ), xi );
+            __m256d Ry = _mm256_sub_pd( _mm256_loadu_pd( y + j ), yi );
+            __m256d magnitude = _mm256_sqrt_pd( _mm256_add_pd( _mm256_mul_pd( Rx, Rx ), _mm256_mul_pd( Ry, Ry ) ) );
+            __m256d threshold = _mm256_mul_pd( three, _mm256_max_pd( ri, _mm256_loadu_pd( radius + j ) ) );
+            __m256d r = _mm256_max_pd( magnitude, threshold );
+            __m256d f = _mm256_div_pd( _mm256_mul_pd( Gmi, _mm256_loadu_pd( mass + j ) ), _mm256_mul_pd( r, r ) );
+
+            // unit() returns (0,0) for coincident bodies
+            __m256d apart = _mm256_cmp_pd( magnitude, zero, _CMP_GT_OQ );
+            __m256d Fx = _mm256_and_pd( apart, _mm256_mul_pd( _mm256_div_pd( Rx, magnitude ), f ) );
+            __m256d Fy = _mm256_and_pd( apart, _mm256_mul_pd( _mm256_div_pd( Ry, magnitude ), f ) );
+
+            sumX = _mm256_add_pd( sumX, Fx );
+            sumY = _mm256_add_pd( sumY, Fy );
+            _mm256_storeu_pd( fx2 + j, _mm256_sub_pd( _mm256_loadu_pd( fx2 + j ), Fx ) );
+            _mm256_storeu_pd( fy2 + j, _mm256_sub_pd( _mm256_loadu_pd( fy2 + j ), Fy ) );
+        }
+
+        double tailX = 0, tailY = 0;
+        rowGravityScalar( x1, y1, mass1, radius1, j, to, x, y, mass, radius, tailX, tailY, fx2, fy2 );
+        fx1 += sum( sumX ) + tailX;
+        fy1 += sum( sumY ) + tailY;
+    }
+
+    __attribute__((target("avx2")))
+    static void pairwiseGravityAVX2( int n, const double* x, const double* y,
+                                     const double* mass, const double* radius,
+                                     double* fx, double* fy)
+    {
+        for( int i = 0; i < n; i++ ) {
+            rowGravityAVX2( x[i], y[i], mass[i], radius[i], i + 1, n, x, y, mass, radius,
+                            fx[i], fy[i], fx, fy );
+        }
+    }
+
+    __attribute__((target("avx2")))
+    static void crossGravityAVX2( int n1, const double* x1, const double* y1,
+                                  const double* mass1, const double* radius1,
+                                  int n2, const double* x2, const double* y2,
+                                  const double* mass2, const double* radius2,
+                                  double* fx1, double* fy1, double* fx2, double* fy2)
+    {
+        for( int i = 0; i < n1; i++ ) {
+            rowGravityAVX2( x1[i], y1[i], mass1[i], radius1[i], 0, n2, x2, y2, mass2, radius2,
+                            fx1[i], fy1[i], fx2, fy2 );
+        }
+    }
+
+    // the four doubles at base[index].  _mm256_i32gather_pd() leaves its
+    // merge source undefined, which GCC warns is maybe uninitialized.
+    __attribute__((target("avx2")))
+    static inline __m256d gather( const double* base, __m128i index )
+    {
+        const __m256d all = _mm256_castsi256_pd( _mm256_set1_epi64x(-1) );
+        return _mm256_mask_i32gather_pd( _mm256_setzero_pd(), base, index, all, 8 );
+    }
+
+    // four candidates at a time, gathered from the packed arrays.  Most
+    // candidates don't touch, so a block with no contacts is dropped before
+    // working out the impulses.
+    __attribute__((target("avx2")))
+    static int collisionContactsAVX2( int count, const std::pair<int,int>* candidates,
+                                      const double* x, const double* y,
+                                      const double* vx, const double* vy,
+                                      const double* mass, const double* radius,
+                                      double travel, Contact* contacts)
+    {
+        const __m256d zero = _mm256_setzero_pd();
+        const __m256d sweep = _mm256_set1_pd( travel );
+        const __m256d two = _mm256_set1_pd(2);
+        // candidates are (first, second) int pairs; split them into the
+        // four firsts and the four seconds.
+        const __m256i split = _mm256_setr_epi32( 0, 2, 4, 6, 1, 3, 5, 7 );
+        int found = 0;
+        int k = 0;
+        for( ; k + 4 <= count; k += 4 ) {
+            __m256i both = _mm256_permutevar8x32_epi32(
+                _mm256_loadu_si256( (const __m256i*)( candidates + k ) ), split );
+            __m128i first = _mm256_castsi256_si128( both );
+            __m128i second = _mm256_extracti128_si256( both, 1 );
+
+            __m256d Rx = _mm256_sub_pd( gather( x, second ), gather( x, first ) );
+            __m256d Ry = _mm256_sub_pd( gather( y, second ), gather( y, first ) );
+            __m256d r = _mm256_sqrt_pd( _mm256_add_pd( _mm256_mul_pd( Rx, Rx ), _mm256_mul_pd( Ry, Ry ) ) );
+            __m256d overlap = _mm256_sub_pd( _mm256_add_pd( gather( radius, first ),
+                                                            gather( radius, second ) ), r );
+            // collision() gives up when overlap < 0, so keep everything else
+            int touching = _mm256_movemask_pd( _mm256_cmp_pd( overlap, zero, _CMP_NLT_UQ ) );
+            // the rest can only meet within the step if they're no further
+            // apart than they can close in it; those few go through the
+            // scalar sweep.
+            int sweeping = 0;
+            if ( travel != 0 ) {
+                __m256d Vx = _mm256_mul_pd( _mm256_sub_pd( gather( vx, second ),
+                                                           gather( vx, first ) ), sweep );
+                __m256d Vy = _mm256_mul_pd( _mm256_sub_pd( gather( vy, second ),
+                                                           gather( vy, first ) ), sweep );
+                __m256d closing = _mm256_sqrt_pd( _mm256_add_pd( _mm256_mul_pd( Vx, Vx ), _mm256_mul_pd( Vy, Vy ) ) );
+                sweeping = _mm256_movemask_pd( _mm256_cmp_pd( _mm256_add_pd( overlap, closing ), zero, _CMP_NLT_UQ ) )
+                           & ~touching;
+            }
+            if ( !touching && !sweeping ) continue;
+
+            __m256d apart = _mm256_cmp_pd( r, zero, _CMP_GT_OQ );
+            __m256d axisX = _mm256_and_pd( apart, _mm256_div_pd( Rx, r ) );
+            __m256d axisY = _mm256_and_pd( apart, _mm256_div_pd( Ry, r ) );
+            __m256d m1 = gather( mass, first );
+            __m256d m2 = gather( mass, second );
+            __m256d p1 = _mm256_mul_pd( _mm256_add_pd( _mm256_mul_pd( gather( vx, first ), axisX ),
+                                                       _mm256_mul_pd( gather( vy, first ), axisY ) ), m1 );
+            __m256d p2 = _mm256_mul_pd( _mm256_add_pd( _mm256_mul_pd( gather( vx, second ), axisX ),
+                                                       _mm256_mul_pd( gather( vy, second ), axisY ) ), m2 );
+            __m256d vc = _mm256_div_pd( _mm256_add_pd( p1, p2 ), _mm256_add_pd( m1, m2 ) );
+            __m256d impulse = _mm256_mul_pd( two, _mm256_sub_pd( p1, _mm256_mul_pd( vc, m1 ) ) );
+
+            double lanesX[4], lanesY[4], lanesOverlap[4], lanesImpulse[4];
+            _mm256_storeu_pd( lanesX, axisX );
+            _mm256_storeu_pd( lanesY, axisY );
+            _mm256_storeu_pd( lanesOverlap, overlap );
+            _mm256_storeu_pd( lanesImpulse, impulse );
+            for( int lane = 0; lane < 4; lane++ ) {
+                if ( sweeping & (1 << lane) ) {
+                    if ( collisionContactsScalar( 1, candidates + k + lane, x, y, vx, vy, mass, radius,
+                                                  travel, contacts + found ) ) {
+                        contacts[found++].pair = k + lane;
+                    }
+                    continue;
+                }
+                if ( !( touching & (1 << lane) ) ) continue;
+                Contact& contact = contacts[found++];
+                contact.pair = k + lane;
+                contact.axisX = lanesX[lane];
+                contact.axisY = lanesY[lane];
+                contact.overlap = lanesOverlap[lane];
+                contact.impulse = lanesImpulse[lane];
+                contact.impact = 0;
+            }
+        }
+
+        int rest = collisionContactsScalar( count - k, candidates + k, x, y, vx, vy, mass, radius,
+                                            travel, contacts + found );
+        for( int c = found; c < found + rest; c++ ) contacts[c].pair += k;
+        return found + rest;
+    }
+
+    __attribute__((target("sse2")))
+    static void keyedCopySSE2( int count, const unsigned* from, unsigned* to, unsigned key, unsigned mask )
+    {
+        const __m128i keys = _mm_set1_epi32( int(key) );
+        const __m128i masks = _mm_set1_epi32( int(mask) );
+        int i = 0;
+        for( ; i + 4 <= count; i += 4 ) {
+            __m128i source = _mm_loadu_si128( reinterpret_cast<const __m128i*>( from + i ) );
+            __m128i keyed = _mm_cmpeq_epi32( _mm_and_si128( source, masks ), keys );
+            int bits = _mm_movemask_epi8(keyed);
+            if ( bits == 0xffff ) continue;
+            __m128i* target = reinterpret_cast<__m128i*>( to + i );
+            if ( bits != 0 ) {
+                __m128i kept = _mm_and_si128( keyed, _mm_loadu_si128(target) );
+                source = _mm_or_si128( kept, _mm_andnot_si128( keyed, source ) );
+            }
+            _mm_storeu_si128( target, source );
+        }
+        keyedCopyScalar( count - i, from + i, to + i, key, mask );
+    }
+
+    __attribute__((target("avx2")))
+    static void keyedCopyAVX2( int count, const unsigned* from, unsigned* to, unsigned key, unsigned mask )
+    {
+        const __m256i keys = _mm256_set1_epi32( int(key) );
+        const __m256i masks = _mm256_set1_epi32( int(mask) );
+        int i = 0;
+        for( ; i + 8 <= count; i += 8 ) {
+            __m256i source = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( from + i ) );
+            __m256i keyed = _mm256_cmpeq_epi32( _mm256_and_si256( source, masks ), keys );
+            int bits = _mm256_movemask_epi8(keyed);
+            if ( bits == -1 ) continue;
+            __m256i* target = reinterpret_cast<__m256i*>( to + i );
+            if ( bits != 0 ) source = _mm256_blendv_epi8( source, _mm256_loadu_si256(target), keyed );
+            _mm256_storeu_si256( target, source );
+        }
+        // not through keyedCopySSE2(): its legacy SSE instructions would
+        // stall on the upper halves this leaves behind, once for every row.
+        if ( i + 4 <= count ) {
+            __m128i source = _mm_loadu_si128( reinterpret_cast<const __m128i*>( from + i ) );
+            __m128i keyed = _mm_cmpeq_epi32( _mm_and_si128( source, _mm256_castsi256_si128(masks) ),
+                                             _mm256_castsi256_si128(keys) );
+            __m128i* target = reinterpret_cast<__m128i*>( to + i );
+            _mm_storeu_si128( target, _mm_blendv_epi8( source, _mm_loadu_si128(target), keyed ) );
+            i += 4;
+        }
+        _mm256_zeroupper();
+        keyedCopyScalar( count - i, from + i, to + i, key, mask );
+    }
+#endif
+
+/*********************  Dispatch  *********************/
+    static bool haveAVX2()
+    {
+#ifdef PATTERN_SPACE_AVX2_KERNELS
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+
+    static KernelPath& currentPath()
+    {
+        static KernelPath path = haveAVX2() ? AVX2_KERNELS : SCALAR_KERNELS;
+        return path;
+    }
+
+    static BlitPath bestBlits()
+    {
+#ifdef PATTERN_SPACE_AVX2_KERNELS
+        __builtin_cpu_init();
+        if ( __builtin_cpu_supports("avx2") ) return AVX2_BLITS;
+        if ( __builtin_cpu_supports("sse2") ) return SSE2_BLITS;
+#endif
+        return SCALAR_BLITS;
+    }
+
+    static BlitPath& currentBlits()
+    {
+        static BlitPath path = bestBlits();
+        return path;
+    }
+
+    BlitPath blitPath()
+    {
+        return currentBlits();
+    }
+
+    BlitPath blitPath(BlitPath path)
+    {
+        if ( path > bestBlits() ) path = bestBlits();
+        currentBlits() = path;
+        return path;
+    }
+
+    KernelPath kernelPath()
+    {
+        return currentPath();
+    }
+
+    KernelPath kernelPath(KernelPath path)
+    {
+        if ( path == AVX2_KERNELS && !haveAVX2() ) path = SCALAR_KERNELS;
+        currentPath() = path;
+        return path;
+    }
+
+    void pairwiseGravity( int n, const double* x, const double* y,
+                          const double* mass, const double* radius,
+                          double* fx, double* fy)
+    {
+#ifdef PATTERN_SPACE_AVX2_KERNELS
+        if ( currentPath() == AVX2_KERNELS ) {
+            pairwiseGravityAVX2( n, x, y, mass, radius, fx, fy );
+            return;
+        }
+#endif
+        pairwiseGravityScalar( n, x, y, mass, radius, fx, fy );
+    }
+
+    void crossGravity( int n1, const double* x1, const double* y1,
+                       const double* mass1, const double* radius1,
+                       int n2, const double* x2, const double* y2,
+                       const double* mass2, const double* radius2,
+                       double* fx1, double* fy1, double* fx2, double* fy2)
+    {
+#ifdef PATTERN_SPACE_AVX2_KERNELS
+        if ( currentPath() == AVX2_KERNELS ) {
+            crossGravityAVX2( n1, x1, y1, mass1, radius1, n2, x2, y2, mass2, radius2, fx1, fy1, fx2, fy2 );
+            return;
+        }
+#endif
+        crossGravityScalar( n1, x1, y1, mass1, radius1, n2, x2, y2, mass2, radius2, fx1, fy1, fx2, fy2 );
+    }
+
+    int collisionContacts( int count, const std::pair<int,int>* candidates,
+                           const double* x, const double* y,
+                           const double* vx, const double* vy,
+                           const double* mass, const double* radius,
+                           double travel, Contact* contacts)
+    {
+#ifdef PATTERN_SPACE_AVX2_KERNELS
+        if ( currentPath() == AVX2_KERNELS ) {
+            return collisionContactsAVX2( count, candidates, x, y, vx, vy, mass, radius, travel, contacts );
+        }
+#endif
+        return collisionContactsScalar( count, candidates, x, y, vx, vy, mass, radius, travel, contacts );
+    }
+
+    void keyedCopy( int count, const unsigned* from, unsigned* to, unsigned key, unsigned mask )
+    {
+#ifdef PATTERN_SPACE_AVX2_KERNELS
+        if ( currentBlits() == AVX2_BLITS ) {
+            keyedCopyAVX2( count, from, to, key, mask );
+            return;
+        }
+        if ( currentBlits() == SSE2_BLITS ) {
+            keyedCopySSE2( count, from, to, key, mask );
+            return;
+        }
+#endif
+        keyedCopyScalar( count, from, to, key, mask );
+    }
+
+} // end namespace PatternSpace
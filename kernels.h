@@ -0,0 +1,104 @@
+/*
+  Batch Kernels
+
+  gravitate() and collision() work on one pair at a time, going through the
+virtual accessors and a Vector2d::unit() for every pair.  When the Universe
+already knows which pairs it wants, it can pack the positions, velocities,
+masses and radii of the interacting Solids into plain arrays and hand the
+whole batch to one of these kernels instead.
+
+  Each kernel has two implementations.  The scalar one is the same arithmetic
+as mass.cpp, pair by pair.  The AVX2 one does four pairs at a time.  Which one
+runs is decided once, the first time a kernel is called, by asking the CPU
+whether it supports AVX2; kernelPath() can force the scalar path, which is
+handy for comparing the two.  Builds without a compiler that understands
+per-function target attributes only get the scalar path.
+
+  The per-pair results of the two paths are identical, because both use the
+same operations in the same order and sqrt and divide are exact in AVX.  The
+gravity totals differ in the last few bits, because the AVX2 path adds up
+four partial sums per body instead of one.
+
+  pairwiseGravity() adds the total force on every body to fx and fy, which
+the caller must have zeroed (or filled with other forces.)  crossGravity() does
+the same for every pair with one body from each of two sets, always taking
+the body from the first set as mass1, as gravitate() would if the first set
+came earlier.  Together they let a big sum be split into independent tiles.
+
+  collisionContacts() tests the candidate pairs and writes a Contact for each
+pair that overlaps, in the order of the candidates.  It doesn't change
+anything; the caller resolves each contact with bounce() from mass.h, which is
+the second half of collision().  Note that every contact is computed from the
+positions at the start of the batch, whereas calling collision() pair by pair
+would see a Mass that an earlier collision had just shoved aside.  travel is
+the sweep of sweptCollision() to look ahead by; with the AVX2 path, only
+the pairs close enough to meet within it are swept, one at a time.
+
+  keyedCopy() is one row of a color-keyed blit of 32-bit pixels: every
+pixel of the source whose color bits (mask) aren't the key is copied.  It
+has its own choice of path, blitPath(), since there's also SSE2, which
+every x86-64 has, and SDL_BLITS, which tells the Surfaces not to use it at
+all and go through SDL_BlitSurface.  The SSE2 path compares four pixels at
+a time and the AVX2 path eight; a group with nothing to copy is skipped,
+and a group with nothing keyed is stored whole.  All of them write exactly
+the same pixels.
+
+*/
+#ifndef PATTERN_SPACE_KERNELS_INCLUSION_GUARD
+#define PATTERN_SPACE_KERNELS_INCLUSION_GUARD
+
+#include <utility>
+
+namespace PatternSpace {
+
+/*********************  Batch Kernels  *********************/
+    enum KernelPath { SCALAR_KERNELS, AVX2_KERNELS };
+
+    // the path the kernels are using.
+    KernelPath kernelPath();
+    // ask for a particular path.  Asking for AVX2 on a machine that doesn't
+    // have it gets you the scalar path.  Returns the path actually chosen.
+    KernelPath kernelPath(KernelPath path);
+
+    enum BlitPath { SDL_BLITS, SCALAR_BLITS, SSE2_BLITS, AVX2_BLITS };
+
+    // the best the CPU has, to begin with.
+    BlitPath blitPath();
+    // asking for more than the CPU has gets the best it has.  Returns the
+    // path actually chosen.
+    BlitPath blitPath(BlitPath path);
+
+    // a collision found by collisionContacts(): which candidate it was, and
+    // the axis, overlap, impulse and impact that collision() would have used.
+    struct Contact {
+        int pair;
+        double axisX, axisY;
+        double overlap;
+        double impulse;
+        double impact;      // travel before they touch; 0 if they overlap
+    };
+
+    void pairwiseGravity( int n, const double* x, const double* y,
+                          const double* mass, const double* radius,
+                          double* fx, double* fy);
+
+    void crossGravity( int n1, const double* x1, const double* y1,
+                       const double* mass1, const double* radius1,
+                       int n2, const double* x2, const double* y2,
+                       const double* mass2, const double* radius2,
+                       double* fx1, double* fy1, double* fx2, double* fy2);
+
+    // returns the number of Contacts written to contacts, which must have
+    // room for one per candidate.
+    int collisionContacts( int count, const std::pair<int,int>* candidates,
+                           const double* x, const double* y,
+                           const double* vx, const double* vy,
+                           const double* mass, const double* radius,
+                           double travel, Contact* contacts);
+
+    // copy count pixels from from to to, except those whose bits under
+    // mask are key.
+    void keyedCopy( int count, const unsigned* from, unsigned* to, unsigned key, unsigned mask );
+
+} // end namespace PatternSpace
+#endif // PATTERN_SPACE_KERNELS_INCLUSION_GUARD
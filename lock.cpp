@@ -0,0 +1,235 @@
+/*
+  Implementation for Resource and friends
+
+  The spinning Resources use GCC's __atomic builtins.  While spinning they
+only read the lock word, and only try to take it once it looks free, so a
+waiting core doesn't keep stealing the cache line from the one holding it.
+
+  FutexResource is the three state mutex from Ulrich Drepper's "Futexes Are
+Tricky".  post() only makes a system call when someone might be asleep.
+
+  The stats are added atomically, because a LockPhase's LockStats may be
+shared by every thread in a TaskPool, and a ReadWriteResource's by all its
+readers.
+
+*/
+#include "lock.h"
+#include "clock.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+namespace PatternSpace {
+
+    // let the other hyperthread have the core while we spin.
+    static inline void relax()
+    {
+#if defined(__i386__) || defined(__x86_64__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+/*********************  Resource  *********************/
+    bool Resource::recordStats = false;
+
+    void Resource::recording(bool state)
+    {
+        recordStats = state;
+    }
+
+    bool Resource::recording()
+    {
+        return recordStats;
+    }
+
+    void Resource::acquire()
+    {
+        if ( !recordStats ) {
+            wait();
+            return;
+        }
+        if ( tryWait() ) {
+            record(false, 0);
+            return;
+        }
+        unsigned long long start = nanoseconds();
+        wait();
+        record(true, nanoseconds() - start);
+    }
+
+    static void add(LockStats& stats, bool waited, unsigned long long nanoseconds)
+    {
+        __atomic_add_fetch( &stats.acquires, 1, __ATOMIC_RELAXED );
+        if ( waited ) {
+            __atomic_add_fetch( &stats.contended, 1, __ATOMIC_RELAXED );
+            __atomic_add_fetch( &stats.waitNanoseconds, nanoseconds, __ATOMIC_RELAXED );
+        }
+    }
+
+    void Resource::record(bool waited, unsigned long long nanoseconds)
+    {
+        add( _stats, waited, nanoseconds );
+        LockStats* phase = LockPhase::active();
+        if ( phase ) add( *phase, waited, nanoseconds );
+    }
+
+    static ResourceKind defaultKind = SPINLOCK;
+
+    void defaultResourceKind(ResourceKind kind)
+    {
+        defaultKind = kind;
+    }
+
+    ResourceKind defaultResourceKind()
+    {
+        return defaultKind;
+    }
+
+    const char* resourceKindName(ResourceKind kind)
+    {
+        switch ( kind ) {
+            case SEMAPHORE: return "semaphore";
+            case SPINLOCK: return "spinlock";
+            case FUTEX: return "futex";
+            case READ_WRITE: return "read-write";
+        }
+        return "unknown";
+    }
+
+    std::auto_ptr<Resource> newResource(ResourceKind kind)
+    {
+        switch ( kind ) {
+            case SPINLOCK:
+                return std::auto_ptr<Resource>( new SpinResource );
+#ifdef __linux__
+            case FUTEX:
+                return std::auto_ptr<Resource>( new FutexResource );
+#endif
+            case READ_WRITE:
+                return std::auto_ptr<Resource>( new ReadWriteResource );
+            default:
+                return std::auto_ptr<Resource>( new SemaphoreResource );
+        }
+    }
+
+    std::auto_ptr<Resource> newResource()
+    {
+        return newResource(defaultKind);
+    }
+
+/*********************  SpinResource  *********************/
+    void SpinResource::wait()
+    {
+        while ( !tryWait() ) {
+            while ( __atomic_load_n( &locked, __ATOMIC_RELAXED ) ) relax();
+        }
+    }
+
+    void SpinResource::post()
+    {
+        __atomic_store_n( &locked, 0, __ATOMIC_RELEASE );
+    }
+
+    bool SpinResource::tryWait()
+    {
+        return __atomic_exchange_n( &locked, 1, __ATOMIC_ACQUIRE ) == 0;
+    }
+
+/*********************  FutexResource  *********************/
+#ifdef __linux__
+    static void futex(int* address, int operation, int value)
+    {
+        syscall( SYS_futex, address, operation, value, 0, 0, 0 );
+    }
+
+    void FutexResource::wait()
+    {
+        int c = 0;
+        if ( __atomic_compare_exchange_n( &state, &c, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED ) ) return;
+        // it's held; mark it as having a sleeper and sleep until it's free.
+        if ( c != 2 ) c = __atomic_exchange_n( &state, 2, __ATOMIC_ACQUIRE );
+        while ( c != 0 ) {
+            futex( &state, FUTEX_WAIT_PRIVATE, 2 );
+            c = __atomic_exchange_n( &state, 2, __ATOMIC_ACQUIRE );
+        }
+    }
+
+    void FutexResource::post()
+    {
+        if ( __atomic_fetch_sub( &state, 1, __ATOMIC_RELEASE ) != 1 ) {
+            __atomic_store_n( &state, 0, __ATOMIC_RELEASE );
+            futex( &state, FUTEX_WAKE_PRIVATE, 1 );
+        }
+    }
+
+    bool FutexResource::tryWait()
+    {
+        int c = 0;
+        return __atomic_compare_exchange_n( &state, &c, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED );
+    }
+#endif
+
+/*********************  ReadWriteResource  *********************/
+    void ReadWriteResource::wait()
+    {
+        while ( !tryWait() ) {
+            while ( __atomic_load_n( &state, __ATOMIC_RELAXED ) != 0 ) relax();
+        }
+    }
+
+    void ReadWriteResource::post()
+    {
+        __atomic_store_n( &state, 0, __ATOMIC_RELEASE );
+    }
+
+    bool ReadWriteResource::tryWait()
+    {
+        int c = 0;
+        return __atomic_compare_exchange_n( &state, &c, -1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED );
+    }
+
+    void ReadWriteResource::readWait()
+    {
+        while ( !tryReadWait() ) {
+            while ( __atomic_load_n( &state, __ATOMIC_RELAXED ) < 0 ) relax();
+        }
+    }
+
+    void ReadWriteResource::readPost()
+    {
+        __atomic_sub_fetch( &state, 1, __ATOMIC_RELEASE );
+    }
+
+    bool ReadWriteResource::tryReadWait()
+    {
+        int c = __atomic_load_n( &state, __ATOMIC_RELAXED );
+        while ( c >= 0 ) {
+            if ( __atomic_compare_exchange_n( &state, &c, c + 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED ) ) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void ReadWriteResource::readAcquire()
+    {
+        if ( !recording() ) {
+            readWait();
+            return;
+        }
+        if ( tryReadWait() ) {
+            record(false, 0);
+            return;
+        }
+        unsigned long long start = nanoseconds();
+        readWait();
+        record(true, nanoseconds() - start);
+    }
+
+/*********************  LockPhase  *********************/
+    __thread LockStats* LockPhase::current = 0;
+
+} // end namespace PatternSpace
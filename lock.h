@@ -1,81 +1,242 @@
-/*
-    Resource, Lock
-    
-  Wraps SDL thread syncronization fuctionality in C++ objects.
-  
-  Resource is a thin wrapper around SDL_Semaphore.
-
-  Lock implements the RAII idiom: simply instantiate a Lock on a Resource at
-the beginning of a scope to lock it until the end of the scope (in an exception
-safe way.)
-  
-  TODO: Resource could be an ABC, becuase there are other ways of implementing
-resources, even in SDL.  Lock depends only on wait() and post(), and that's
-really the essence of a mutex.
-
-  Note: if you use tryWait() or waitTimeout(), be prepared to catch a possible
-ResourceError exception.
-      
-*/
-#ifndef PATTERN_SPACE_MUTEX_INCLUSION_GUARD
-#define PATTERN_SPACE_MUTEX_INCLUSION_GUARD
-#include <SDL/SDL.h>
-#include <SDL/SDL_thread.h>
-
-namespace PatternSpace {
-    
-/*********************  Resource  *********************/
-    class Resource {
-    public:
-        class ResourceError {};  // exception class
-        
-        // a default of one means one thread can have the lock at a time.
-        Resource(int i=1) { sdl_sem = SDL_CreateSemaphore(i); }
-        ~Resource() { SDL_DestroySemaphore(sdl_sem);   }
-        
-        void wait() { SDL_SemWait(sdl_sem); }
-        void post() { SDL_SemPost(sdl_sem); }
-        int value() const { SDL_SemValue(sdl_sem); }
-        
-        bool tryWait()
-        { 
-            return boolOrError( SDL_SemTryWait(sdl_sem) ); 
-        }
-        
-        bool waitTimeout(int timeout)
-        { 
-            return boolOrError( SDL_SemWaitTimeout(sdl_sem, timeout) ); 
-        }
-        
-    private:
-        SDL_sem * sdl_sem;
-        // change the SDL error return code to a C++ exception.
-        static bool boolOrError(Uint32 x) {
-            if ( x == 0 ) return true;
-            else if ( x == -1 ) throw ResourceError();
-            else return false;
-        }
-    }; // end class Resource
-    
-/*********************  Lock  *********************/
-    // RAII for a lock on a Resources
-    class Lock {
-    public:
-        explicit Lock(Resource& target):
-            resource(target) {
-            resource.wait();  // get the resource
-        }
-        ~Lock() { 
-            resource.post();  // release the resource
-        }
-
-    private:
-        Resource& resource;
-        //declare copy and assignment private; Locks shouldn't be copied
-        Lock& operator=(Lock&);
-        Lock(Lock&);
-
-    }; // end class Lock
-    
-} // end namespace PatternSpace
-#endif  // PATTERN_SPACE_MUTEX_INCLUSION_GUARD
+/*
+    Resource, Lock
+
+  Wraps thread syncronization fuctionality in C++ objects.
+
+  Resource is an Abstract Base Class for anything that can be locked.  Lock
+depends only on wait() and post(), and that's really the essence of a mutex.
+There are several implementations, because they suit different jobs:
+
+  SemaphoreResource is a thin wrapper around SDL_Semaphore.  It's the only
+one that counts, so it's the one to use for signalling between threads, but
+every wait() and post() is a trip into the kernel.
+
+  SpinResource is a single word that's spun on until it's free.  It never
+sleeps, so it's the cheapest when the lock is almost never contended and is
+only held for a moment, and a waste of a core when it isn't.
+
+  FutexResource is a mutex that takes one atomic operation when it's free,
+and only goes to sleep in the kernel (with a Linux futex) when it isn't.
+Elsewhere, newResource() hands out a SemaphoreResource instead.
+
+  ReadWriteResource can be held by any number of readers at once, with
+readWait() and readPost() (or a ReadLock), or by a single writer, with the
+usual wait() and post().  Both sides spin.
+
+  Lock implements the RAII idiom: simply instantiate a Lock on a Resource at
+the beginning of a scope to lock it until the end of the scope (in an exception
+safe way.)  ReadLock does the same for a reader.
+
+  Contention statistics: when Resource::recording() is on, every Lock keeps
+count of how often it acquired its Resource, how often it had to wait for it,
+and how long it waited, in nanoseconds.  The counts go into the Resource's own
+stats(), and also into the LockStats of the current LockPhase, if the thread
+is in one.  A LockPhase is a scope, like a Lock, that names where the time is
+being spent; the Universe uses one for each phase of a step.  Recording costs a
+tryWait() and a clock read per contended acquire, so it's off by default.
+
+  Note: if you use SemaphoreResource's tryWait() or waitTimeout(), be prepared
+to catch a possible ResourceError exception.
+
+*/
+#ifndef PATTERN_SPACE_MUTEX_INCLUSION_GUARD
+#define PATTERN_SPACE_MUTEX_INCLUSION_GUARD
+#include <memory>
+#include <SDL/SDL.h>
+#include <SDL/SDL_thread.h>
+
+namespace PatternSpace {
+
+/*********************  LockStats  *********************/
+    struct LockStats {
+        LockStats(): acquires(0), contended(0), waitNanoseconds(0) {}
+        unsigned long acquires;
+        unsigned long contended;            // acquires that had to wait
+        unsigned long long waitNanoseconds;
+        void clear() { acquires = contended = 0; waitNanoseconds = 0; }
+    };
+
+/*********************  Resource  *********************/
+    // ABC
+    class Resource {
+    public:
+        class ResourceError {};  // exception class
+
+        virtual ~Resource() {}
+        virtual void wait() = 0;
+        virtual void post() = 0;
+        virtual bool tryWait() = 0;
+
+        // wait(), and keep count if recording.  Lock uses these.
+        void acquire();
+        void release() { post(); }
+
+        const LockStats& stats() const { return _stats; }
+        static void recording(bool state);
+        static bool recording();
+
+    protected:
+        Resource() {}
+        // add one acquire to our stats and the current LockPhase's.
+        void record(bool waited, unsigned long long nanoseconds);
+
+    private:
+        LockStats _stats;
+        static bool recordStats;
+
+        // Resources can't be copied
+        Resource& operator=(const Resource&);
+        Resource(const Resource&);
+    }; // end class Resource
+
+    enum ResourceKind { SEMAPHORE, SPINLOCK, FUTEX, READ_WRITE };
+
+    // a new mutex of the given kind, or of the default kind, which starts
+    // out as SPINLOCK.
+    std::auto_ptr<Resource> newResource(ResourceKind kind);
+    std::auto_ptr<Resource> newResource();
+    void defaultResourceKind(ResourceKind kind);
+    ResourceKind defaultResourceKind();
+    const char* resourceKindName(ResourceKind kind);
+
+/*********************  SemaphoreResource  *********************/
+    class SemaphoreResource: public Resource {
+    public:
+        // a default of one means one thread can have the lock at a time.
+        SemaphoreResource(int i=1) { sdl_sem = SDL_CreateSemaphore(i); }
+        ~SemaphoreResource() { SDL_DestroySemaphore(sdl_sem);   }
+
+        void wait() { SDL_SemWait(sdl_sem); }
+        void post() { SDL_SemPost(sdl_sem); }
+        int value() const { return SDL_SemValue(sdl_sem); }
+
+        bool tryWait()
+        {
+            return boolOrError( SDL_SemTryWait(sdl_sem) );
+        }
+
+        bool waitTimeout(int timeout)
+        {
+            return boolOrError( SDL_SemWaitTimeout(sdl_sem, timeout) );
+        }
+
+    private:
+        SDL_sem * sdl_sem;
+        // change the SDL error return code to a C++ exception.
+        static bool boolOrError(Uint32 x) {
+            if ( x == 0 ) return true;
+            else if ( x == -1 ) throw ResourceError();
+            else return false;
+        }
+    }; // end class SemaphoreResource
+
+/*********************  SpinResource  *********************/
+    class SpinResource: public Resource {
+    public:
+        SpinResource(): locked(0) {}
+        void wait();
+        void post();
+        bool tryWait();
+    private:
+        int locked;
+    }; // end class SpinResource
+
+#ifdef __linux__
+/*********************  FutexResource  *********************/
+    class FutexResource: public Resource {
+    public:
+        FutexResource(): state(0) {}
+        void wait();
+        void post();
+        bool tryWait();
+    private:
+        int state;  // 0 free, 1 held, 2 held and someone may be asleep
+    }; // end class FutexResource
+#endif
+
+/*********************  ReadWriteResource  *********************/
+    class ReadWriteResource: public Resource {
+    public:
+        ReadWriteResource(): state(0) {}
+        // exclusive
+        void wait();
+        void post();
+        bool tryWait();
+        // shared
+        void readWait();
+        void readPost();
+        bool tryReadWait();
+        // readWait(), and keep count if recording.  ReadLock uses these.
+        void readAcquire();
+        void readRelease() { readPost(); }
+    private:
+        int state;  // number of readers, or -1 for a writer
+    }; // end class ReadWriteResource
+
+/*********************  Lock  *********************/
+    // RAII for a lock on a Resources
+    class Lock {
+    public:
+        explicit Lock(Resource& target):
+            resource(target) {
+            resource.acquire();  // get the resource
+        }
+        ~Lock() {
+            resource.release();  // release the resource
+        }
+
+    private:
+        Resource& resource;
+        //declare copy and assignment private; Locks shouldn't be copied
+        Lock& operator=(Lock&);
+        Lock(Lock&);
+
+    }; // end class Lock
+
+    // RAII for a shared lock on a ReadWriteResource
+    class ReadLock {
+    public:
+        explicit ReadLock(ReadWriteResource& target):
+            resource(target) {
+            resource.readAcquire();
+        }
+        ~ReadLock() {
+            resource.readRelease();
+        }
+
+    private:
+        ReadWriteResource& resource;
+        ReadLock& operator=(ReadLock&);
+        ReadLock(ReadLock&);
+
+    }; // end class ReadLock
+
+/*********************  LockPhase  *********************/
+    // while a LockPhase is in scope, Locks on this thread also add their
+    // stats to its LockStats.  LockPhases nest; the innermost one counts.
+    class LockPhase {
+    public:
+        explicit LockPhase(LockStats& stats):
+            previous(current) {
+            current = &stats;
+        }
+        ~LockPhase() {
+            current = previous;
+        }
+
+        // the LockStats being recorded into on this thread, if any.
+        static LockStats* active() { return current; }
+        // for handing the phase on to another thread (see TaskPool.)
+        static void activate(LockStats* stats) { current = stats; }
+
+    private:
+        LockStats* previous;
+        static __thread LockStats* current;
+
+        LockPhase& operator=(LockPhase&);
+        LockPhase(LockPhase&);
+
+    }; // end class LockPhase
+
+} // end namespace PatternSpace
+#endif  // PATTERN_SPACE_MUTEX_INCLUSION_GUARD
@@ -1,160 +1,344 @@
-/*
-    PatternSpace
-
-  PatternSpace is a C++ playground.  Reading Head First Design Patterns, I was
-struck by how silly the examples were.  I decided that it wasn't possible to
-explore the concepts of good design in a vaccuum like that.  I thought of
-two alternatives: build a playground, or work with a real data set.
-
-By a playground, I mean a program that supplies a lot of objects to interact
-with and takes care of a lot of IO issues.  Working with a data set is more
-suited to the study of algorithms, while a playground is more suited playing
-with object oriented programming.
-
-  I was reading Scott Meyer's Effective C++ while working on this.  Most of
-the design decisions were informed in some way by that book.
-
-  I wanted something graphical, but 2D for simplicity.  I knew that physics
-could be a rich source of inspiration.  Eventually, I decided on some kind of
-2D space game, where you fly around in a little ship using asteroid-like
-controls.  PatternSpace is first and foremost a playground in which
-I can embed objects and implement various Design Patterns and immediately
-watch them do something cool.
-
-  PatternSpace is built on the SDL and SDL_gfx libraries.  This gives me a
-simple API to work with that I can take to any machine I choose.  These are
-C libraries, so I encapsulate the behavor I want in my own classes.  It also
-depends on boost/shared_ptr<>, which is too useful to do without.
-
-  Remember to link in SDL and SDL_gfx when compiling PatternSpace.  Thanks to
-Rob Loach, who provided the Dev-C++ dev kit example which got me started.
-
-*/
-
-#include <stdio.h>
-#include <stdlib.h>
-#include "vector2d.h"
-#include "solid.h"
-#include "universe.h"
-#include "factories.h"
-#include "ship.h"
-
-#include <SDL/SDL_framerate.h>		// SDL_gfx Framerate Manager
-#include <SDL/SDL_thread.h>
-using namespace PatternSpace;
-
-void sendEventsToControls(Controls &c);
-
-bool isRunning = true;
-
-int paint(void *);
-
-int main(int argc, char *argv[]){
-
-    // Instantiate the framework
-    Screen screen;
-    screen.origin(Vector2d(0,0));
-    Background background("images/stars.bmp");
-    Universe universe( &screen, &background );
-
-    // Load some stuff
-    universe.add( newRock(Vector2d(-400,100), Vector2d(-.2,.1) ) );
-    universe.add( newRock(Vector2d(0,500), Vector2d(.05,0) ) );
-    universe.add( newRock(Vector2d(250,40), Vector2d(-.3,-.2) ) );
-    universe.add( newBigRock(Vector2d(250,10), Vector2d(0,.3) ) );
-    universe.add( newRock(Vector2d(-300,-100), Vector2d(.02,-.02) ) );
-    universe.add( newRock(Vector2d(-50,-200), Vector2d(.2,-.05) ) );
-    universe.add( newAlien(Vector2d(100,150), Vector2d(-.3,0) ) );
-
-    // Load the ship
-    boost::shared_ptr<Ship> pShip = newShip( Vector2d(0,0), Vector2d() );
-    boost::shared_ptr<Solid> pShipSolid = pShip;
-    universe.add( pShipSolid );
-
-    // spawn off graphics thread.
-    SDL_Thread * paintThread = SDL_CreateThread( paint, &universe);
-
-    // main thread becomes the physics simulation thread.
-    FPSmanager fpsm;
-    SDL_initFramerate(&fpsm);
-	SDL_setFramerate(&fpsm, 150); // Steps Per Second
-
-	int tick,lastTick;
-    double deltaTick;
-	tick = SDL_GetTicks();
-
-	while(isRunning){
-	    lastTick = tick;
-	    tick = SDL_GetTicks();
-	    deltaTick = double(tick - lastTick);
-	    deltaTick = deltaTick > 1 ? deltaTick : 1;
-        universe.simulateAll(deltaTick);
-        universe.center( pShip->position() );
-        SDL_framerateDelay(&fpsm);
-        //SDL_Delay(1);
-        sendEventsToControls(*pShip);
-
-	}  // end infinite loop
-
-    // join threads before exiting
-    SDL_WaitThread(paintThread, 0);
-
-	return 0;
-}  // end main
-
-// this function is meant to be launched as a new thread.  It returns
-// only when the global isRunning becomes false.  It paints each frame on
-// the screen.
-int paint( void * pUniverse) {
-    Universe& universe = *static_cast<Universe*>(pUniverse);
-
-    FPSmanager fpsm;
-	SDL_initFramerate(&fpsm);
-	SDL_setFramerate(&fpsm, 24); // Frames Per Second
-
-    while (isRunning) {
-        universe.drawAll();
-        SDL_framerateDelay(&fpsm);
-    }
-}
-
-// map SDL keyboard events to notifications
-// ESC key -> quit
-// arrow keys ->  notify Controls object
-// space bar -> notify Controls object of Primary Action (fire a missle.)
-void sendEventsToControls(Controls &controls) {
-    SDL_Event event;
-	while(SDL_PollEvent(&event)){
-        bool state = false;
-        switch(event.type) {
-            case SDL_QUIT:
-    			isRunning = false;
-	       		break;
-	       	case SDL_KEYDOWN:
-                state = true;
-                // fall through
-            case SDL_KEYUP:
-                switch(event.key.keysym.sym) {
-                    case SDLK_ESCAPE:
-        				isRunning = false;
-        				break;
-        			case SDLK_UP:
-                        controls.up(state);
-                        break;
-        			case SDLK_DOWN:
-                        controls.down(state);
-                        break;
-        			case SDLK_LEFT:
-                        controls.left(state);
-                        break;
-        			case SDLK_RIGHT:
-                        controls.right(state);
-                        break;
-        			case SDLK_SPACE:
-                        controls.primary(state);
-                        break;
-                }  // end key symbol switch
-			break;
-		} // end event type switch
-    }  // end PollEvent loop
-}
+/*
+    PatternSpace
+
+  PatternSpace is a C++ playground.  Reading Head First Design Patterns, I was
+struck by how silly the examples were.  I decided that it wasn't possible to
+explore the concepts of good design in a vaccuum like that.  I thought of
+two alternatives: build a playground, or work with a real data set.
+
+By a playground, I mean a program that supplies a lot of objects to interact
+with and takes care of a lot of IO issues.  Working with a data set is more
+suited to the study of algorithms, while a playground is more suited playing
+with object oriented programming.
+
+  I was reading Scott Meyer's Effective C++ while working on this.  Most of
+the design decisions were informed in some way by that book.
+
+  I wanted something graphical, but 2D for simplicity.  I knew that physics
+could be a rich source of inspiration.  Eventually, I decided on some kind of
+2D space game, where you fly around in a little ship using asteroid-like
+controls.  PatternSpace is first and foremost a playground in which
+I can embed objects and implement various Design Patterns and immediately
+watch them do something cool.
+
+  PatternSpace is built on the SDL and SDL_gfx libraries.  This gives me a
+simple API to work with that I can take to any machine I choose.  These are
+C libraries, so I encapsulate the behavor I want in my own classes.  It also
+depends on boost/shared_ptr<>, which is too useful to do without.
+
+  Remember to link in SDL and SDL_gfx when compiling PatternSpace.  Thanks to
+Rob Loach, who provided the Dev-C++ dev kit example which got me started.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vector2d.h"
+#include "solid.h"
+#include "universe.h"
+#include "factories.h"
+#include "ship.h"
+#include "journal.h"
+#include "imagestore.h"
+#include "clock.h"
+
+#include <SDL/SDL_framerate.h>		// SDL_gfx Framerate Manager
+#include <SDL/SDL_thread.h>
+using namespace PatternSpace;
+
+void sendEventsToControls(Controls &c);
+
+bool isRunning = true;
+
+int paint(void *);
+int replay(Universe& universe, Journal& journal, SolidHandle ship);
+Controls& controlsOf(Universe& universe, SolidHandle ship);
+
+int main(int argc, char *argv[]){
+
+    // --threads N shares the interaction work out to N threads.
+    // --locks semaphore|spinlock|futex|read-write picks the kind of lock
+    //   each Solid gets.
+    // --active-radius R only simulates fully within R pixels of the ship.
+    // --swept looks for collisions along the whole of each step.
+    // --step-hz N runs the physics N steps a second instead of 60; with
+    //   --swept, it can go much lower without missiles missing.
+    // --contact-iterations N solves the contacts together, so that packed
+    //   rocks settle.
+    // --atlas waits for the images to load, then packs them and all their
+    //   rotations into an Atlas before the game starts.
+    // --rotation-steps N rounds the angles sprites are drawn at to one of N
+    //   to a full turn, so their rotations can be cached; 0 rotates exactly.
+    // --dirty-rects only redraws and presents the parts of the screen that
+    //   changed, while the camera holds still.
+    // --paint-threads N draws each frame in bands, on N threads.
+    // --parallax D adds a second star field, which moves D times as far
+    //   as the camera.
+    // --lock-report prints how much time each phase spent waiting for
+    //   locks when the game exits.
+    // --pool-report prints how often missiles and explosions were recycled
+    //   when the game exits.
+    // --record FILE writes a Journal of the game to FILE on exit.
+    // --replay FILE plays a Journal back as fast as possible, without a
+    //   window, and checks that it ends up where it did the first time.
+    int threads = 1;
+    double activeRadius = 0;
+    bool swept = false;
+    double stepRate = 60;
+    int contactIterations = 0;
+    bool atlas = false;
+    Screen::Presentation presentation = Screen::FLIP;
+    double parallax = 0;
+    int paintThreads = 1;
+    bool lockReport = false;
+    bool poolReport = false;
+    const char* recordFile = 0;
+    const char* replayFile = 0;
+    for( int arg = 1; arg < argc; arg++ ) {
+        if ( strcmp( argv[arg], "--threads" ) == 0 && arg + 1 < argc ) {
+            threads = atoi( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--locks" ) == 0 && arg + 1 < argc ) {
+            arg++;
+            for( int kind = SEMAPHORE; kind <= READ_WRITE; kind++ ) {
+                if ( strcmp( argv[arg], resourceKindName( ResourceKind(kind) ) ) == 0 ) {
+                    defaultResourceKind( ResourceKind(kind) );
+                }
+            }
+        } else if ( strcmp( argv[arg], "--active-radius" ) == 0 && arg + 1 < argc ) {
+            activeRadius = atof( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--swept" ) == 0 ) {
+            swept = true;
+        } else if ( strcmp( argv[arg], "--step-hz" ) == 0 && arg + 1 < argc ) {
+            stepRate = atof( argv[++arg] );
+            if ( stepRate <= 0 ) stepRate = 60;
+        } else if ( strcmp( argv[arg], "--contact-iterations" ) == 0 && arg + 1 < argc ) {
+            contactIterations = atoi( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--atlas" ) == 0 ) {
+            atlas = true;
+        } else if ( strcmp( argv[arg], "--rotation-steps" ) == 0 && arg + 1 < argc ) {
+            RotationCache::steps( atoi( argv[++arg] ) );
+        } else if ( strcmp( argv[arg], "--dirty-rects" ) == 0 ) {
+            presentation = Screen::DIRTY_RECTS;
+        } else if ( strcmp( argv[arg], "--paint-threads" ) == 0 && arg + 1 < argc ) {
+            paintThreads = atoi( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--parallax" ) == 0 && arg + 1 < argc ) {
+            parallax = atof( argv[++arg] );
+        } else if ( strcmp( argv[arg], "--lock-report" ) == 0 ) {
+            lockReport = true;
+        } else if ( strcmp( argv[arg], "--pool-report" ) == 0 ) {
+            poolReport = true;
+        } else if ( strcmp( argv[arg], "--record" ) == 0 && arg + 1 < argc ) {
+            recordFile = argv[++arg];
+        } else if ( strcmp( argv[arg], "--replay" ) == 0 && arg + 1 < argc ) {
+            replayFile = argv[++arg];
+        }
+    }
+    Resource::recording(lockReport);
+
+    // Instantiate the framework
+    Screen screen( replayFile ? Screen::HEADLESS : Screen::WINDOW, presentation );
+    screen.origin(Vector2d(0,0));
+    screen.threads(paintThreads);
+    Background background("images/stars.bmp");
+    if ( parallax > 0 ) background.layer( BitmapImage("images/stars.bmp"), parallax );
+
+    // load the sprites' images in the background; until they're in, the
+    // sprites are invisible rather than holding everything up.
+    if ( !replayFile ) {
+        ImageStore::background(true);
+        ImageStore::warm("images/manifest.txt");
+    }
+
+    Universe universe( &screen, &background );
+    universe.threads(threads);
+    universe.activeRegion(activeRadius, 4);
+    universe.sweptCollisions(swept);
+    universe.contactIterations(contactIterations);
+    standardInteractions(universe);
+
+    // Load some stuff, and the ship
+    Journal journal;
+    if ( replayFile ) {
+        if ( !journal.read(replayFile) ) {
+            fprintf( stderr, "Unable to read journal %s\n", replayFile );
+            return 1;
+        }
+    } else {
+        journal.place( "rock", Vector2d(-400,100), Vector2d(-.2,.1) )
+            .place( "rock", Vector2d(0,500), Vector2d(.05,0) )
+            .place( "rock", Vector2d(250,40), Vector2d(-.3,-.2) )
+            .place( "bigrock", Vector2d(250,10), Vector2d(0,.3) )
+            .place( "rock", Vector2d(-300,-100), Vector2d(.02,-.02) )
+            .place( "rock", Vector2d(-50,-200), Vector2d(.2,-.05) )
+            .place( "alien", Vector2d(100,150), Vector2d(-.3,0) )
+            .place( "ship", Vector2d(0,0), Vector2d() );
+    }
+    SolidHandle ship = journal.populate(universe);
+    universe.follow(ship);
+    if ( atlas ) {
+        ImageStore::background(false);
+        ImageStore::pack();
+    }
+
+    if ( replayFile ) {
+        universe.painter(false);
+        return replay(universe, journal, ship);
+    }
+
+    // spawn off graphics thread.
+    SDL_Thread * paintThread = SDL_CreateThread( paint, &universe);
+
+    // main thread becomes the physics simulation thread.  The physics runs
+    // in fixed steps of PHYSICS_STEP milliseconds, however fast the loop
+    // goes; time that doesn't add up to a whole step is saved for the next
+    // pass.  The paint thread draws in between steps, so the physics doesn't
+    // need to keep up with the frame rate.
+    const double PHYSICS_STEP = 1000.0 / stepRate;
+    journal.stepLength = PHYSICS_STEP;
+    unsigned long steps = 0;
+    // if we fall badly behind, drop the time rather than trying to catch up.
+    const double MAX_BEHIND = 250;
+
+    FPSmanager fpsm;
+    SDL_initFramerate(&fpsm);
+	SDL_setFramerate(&fpsm, 60); // Steps Per Second
+
+    Uint32 tick, lastTick;
+    double unsimulated = 0;
+	tick = SDL_GetTicks();
+
+	while(isRunning){
+	    lastTick = tick;
+	    tick = SDL_GetTicks();
+	    unsimulated += double(tick - lastTick);
+	    if ( unsimulated > MAX_BEHIND ) unsimulated = MAX_BEHIND;
+	    while ( unsimulated >= PHYSICS_STEP ) {
+            universe.simulateAll(PHYSICS_STEP);
+            unsimulated -= PHYSICS_STEP;
+            steps++;
+        }
+        SDL_framerateDelay(&fpsm);
+        //SDL_Delay(1);
+        // look the ship up each time round, since it may have died.
+        Controls& shipControls = controlsOf(universe, ship);
+        RecordingControls recorder(shipControls, journal);
+        recorder.at(steps);
+        sendEventsToControls( recordFile ? static_cast<Controls&>(recorder) : shipControls );
+
+	}  // end infinite loop
+
+    // join threads before exiting
+    SDL_WaitThread(paintThread, 0);
+    ImageStore::background(false);
+
+    if ( lockReport ) {
+        printf( "locks: %s\n", resourceKindName( defaultResourceKind() ) );
+        universe.reportLocks(stdout);
+    }
+    if ( poolReport ) reportPools(stdout);
+
+    if ( recordFile ) {
+        journal.steps = steps;
+        journal.digest = universe.digest();
+        journal.hasDigest = true;
+        if ( !journal.write(recordFile) ) {
+            fprintf( stderr, "Unable to write journal %s\n", recordFile );
+        }
+    }
+
+	return 0;
+}  // end main
+
+// run a Journal's steps back to back, with no painter and no frame limit,
+// and report how long it took and whether it came out the same.
+int replay(Universe& universe, Journal& journal, SolidHandle ship)
+{
+    // a Journal doesn't have to place a ship; then nothing is steered.
+    if ( !universe.find(ship) ) {
+        fprintf( stderr, "Journal places no ship; replaying without controls\n" );
+    }
+    unsigned long long start = nanoseconds();
+    for( unsigned long step = 0; step < journal.steps; step++ ) {
+        journal.replay( step, controlsOf(universe, ship) );
+        universe.simulateAll( journal.stepLength );
+    }
+    double seconds = ( nanoseconds() - start ) / 1e9;
+
+    unsigned long long digest = universe.digest();
+    printf( "replayed %lu steps in %.3f s (%.1f steps/s)\n", journal.steps, seconds,
+            seconds > 0 ? journal.steps / seconds : 0.0 );
+    printf( "digest %016llx", digest );
+    if ( journal.hasDigest ) {
+        if ( digest == journal.digest ) printf( ", as recorded\n" );
+        else printf( ", but %016llx was recorded\n", journal.digest );
+    } else {
+        printf( "\n" );
+    }
+    return ( journal.hasDigest && digest != journal.digest ) ? 2 : 0;
+}
+
+// the ship's Controls, or ones that do nothing once it's gone.
+Controls& controlsOf(Universe& universe, SolidHandle ship)
+{
+    static NoControls none;
+    Ship* pShip = dynamic_cast<Ship*>( universe.find(ship) );
+    return pShip ? static_cast<Controls&>(*pShip) : none;
+}
+
+// this function is meant to be launched as a new thread.  It returns
+// only when the global isRunning becomes false.  It paints each frame on
+// the screen.
+int paint( void * pUniverse) {
+    Universe& universe = *static_cast<Universe*>(pUniverse);
+
+    FPSmanager fpsm;
+	SDL_initFramerate(&fpsm);
+	SDL_setFramerate(&fpsm, 24); // Frames Per Second
+
+    while (isRunning) {
+        universe.drawAll();
+        SDL_framerateDelay(&fpsm);
+    }
+}
+
+// map SDL keyboard events to notifications
+// ESC key -> quit
+// arrow keys ->  notify Controls object
+// space bar -> notify Controls object of Primary Action (fire a missle.)
+void sendEventsToControls(Controls &controls) {
+    SDL_Event event;
+	while(SDL_PollEvent(&event)){
+        bool state = false;
+        switch(event.type) {
+            case SDL_QUIT:
+    			isRunning = false;
+	       		break;
+	       	case SDL_KEYDOWN:
+                state = true;
+                // fall through
+            case SDL_KEYUP:
+                switch(event.key.keysym.sym) {
+                    case SDLK_ESCAPE:
+        				isRunning = false;
+        				break;
+        			case SDLK_UP:
+                        controls.up(state);
+                        break;
+        			case SDLK_DOWN:
+                        controls.down(state);
+                        break;
+        			case SDLK_LEFT:
+                        controls.left(state);
+                        break;
+        			case SDLK_RIGHT:
+                        controls.right(state);
+                        break;
+        			case SDLK_SPACE:
+                        controls.primary(state);
+                        break;
+                }  // end key symbol switch
+			break;
+		} // end event type switch
+    }  // end PollEvent loop
+}
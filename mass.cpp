@@ -1,182 +1,255 @@
-/*
-  Implementation for Mass
-
-  Mostly implements a second-order 2D classical physics simulation in the
-naive way.
-
-  Note that the interactions only make use of the Mass interface, and have
-no knowledge of the various implementations.
-  
-*/
-
-#include "mass.h"
-
-namespace PatternSpace {
-    
-/*********************  Mass  *********************/
-    // TODO: use templates to combine these two implementations
-    Mass& Mass::push(const Vector2d force,const Vector2d offset)
-    {
-        push(force);
-        if ( offset.magnitude() > .0001 ) {
-            torque( cross( force, offset) );
-        }
-        return *this;
-    }
-    
-    Mass& Mass::hit(const Vector2d impulse,const Vector2d offset)
-    {
-        hit(impulse);
-        if ( offset.magnitude() > .0001 ) {
-            twist( cross( impulse, offset ) );
-        }
-        return *this;
-    }
-    
-    // moment of a sphere.  (useful default implementation.)
-    // "I have a solution, but it only works for spherical chickens in
-    //  a vaccuum!"
-    double Mass::moment() const 
-    {
-        double r = radius();
-        return (2.0/5.0) * mass() * r*r;
-    }
-
-/*********************  NewtonianMass  *********************/
-    NewtonianMass::NewtonianMass(double mass,
-                                 double moment,
-                                 double radius,
-                                 Vector2d position,
-                                 Vector2d velocity,
-                                 double angle,
-                                 double rotation):
-        m(mass),
-        I(moment),
-        r(radius),
-        p(position),
-        v(velocity),
-        a(angle),
-        o(rotation),
-        tsum(0),
-        stsum(0),
-        isum(Vector2d(0,0)),
-        fsum(Vector2d(0,0)) 
-    {}
-            
-    NewtonianMass::NewtonianMass(Mass& rhs):
-        m(rhs.mass()),
-        I(rhs.moment()),
-        r(rhs.radius()),
-        p(rhs.position()),
-        v(rhs.velocity()),
-        a(rhs.angle()),
-        o(rhs.rotation()),
-        tsum(0),
-        stsum(0),
-        isum(Vector2d(0,0)),
-        fsum(Vector2d(0,0))
-    {}
-            
-    Mass& NewtonianMass::translate(const Vector2d deltaPosition) {
-        p += deltaPosition;
-        return *this;
-    }
-    
-    Mass& NewtonianMass::push(const Vector2d force) {
-        fsum += force;
-        return *this;
-    }
-    Mass& NewtonianMass::hit(const Vector2d impulse) {
-        isum += impulse;
-        return *this;
-    }   
-    Mass& NewtonianMass::torque(double torque) {
-        tsum += torque;
-        return *this;
-    }
-    Mass& NewtonianMass::twist(double suddenTorque) {
-        stsum += suddenTorque;
-        return *this;
-    }
-    void NewtonianMass::reset() {
-        Vector2d zero(0,0);
-        fsum = zero;
-        isum = zero;
-        tsum = 0;
-        stsum = 0;
-    }
-    void NewtonianMass::clean() {
-        a = fmod(a,360);
-        o = fmod(o,360);
-    }
-    Vector2d NewtonianMass::totalForce(double deltaTime) const {
-        return (fsum * deltaTime) + isum;
-    }
-    double NewtonianMass::totalTorque(double deltaTime) const {
-        return (tsum * deltaTime) + stsum;
-    }
-    void NewtonianMass::step(double deltaTime) {
-        v +=  ( totalForce(deltaTime) / mass() );
-        p +=  v;
-        o += ( totalTorque(deltaTime) / moment() );
-        a += o;
-        reset();
-        clean();   
-    }
-    
-/*********************  Interactions  *********************/
-
-    // applies the gravitational force between two Masses to each.
-    // Effective C++ item 23: prefer non-member non-friends.
-    // G := gravitation constant
-    // R := relative position vector
-    // r := distance between the masses
-    // f := magnitude of the graviational force
-    // F := Force vector on mass1.
-    void gravitate( Mass& mass1, Mass& mass2) {
-        static const double G = .001;
-        Vector2d R = mass2.position() - mass1.position();
-        double r = R.magnitude();
-        
-        // gameplay kludge.  limit forces very near large masses.
-        double threshold = mass1.radius() > mass2.radius() ?
-                            3 * mass1.radius() :
-                            3 * mass2.radius();
-        if (r < threshold) r = threshold;
-        
-        double f = G * mass1.mass() * mass2.mass() / (r*r);
-        Vector2d F = f * R.unit();
-        mass1.push( F );
-        mass2.push( -F );
-    }
-    
-    void collision( Mass& mass1, Mass& mass2 ) {
-        Vector2d R = mass2.position() - mass1.position();
-        double r = R.magnitude();
-        double overlap = ( mass1.radius() + mass2.radius() ) - r;
-        if ( overlap < 0 ) return;
-        Vector2d axis = R.unit();
-        
-        // calculate the velocity of the center of mass along the axis.
-        double p1 = dot( mass1.velocity(), axis) * mass1.mass();
-        double p2 = dot( mass2.velocity(), axis) * mass2.mass();
-        double vc = ( p1 + p2) /( mass1.mass() + mass2.mass() );
-        
-        // applying this impulse will reverse the mass1 relative to the center
-        // of mass, i.e. an elastic collision.
-        double impulse = 2*( p1 - vc * mass1.mass());
-        // Impulse Vector
-        Vector2d I = axis * impulse;
-
-        // ok, we're ready to do the actual collision.  Before we do, we
-        // move the two masses so they don't overlap.  The +1 adds one pixel
-        // of padding.
-        mass1.translate( -axis * (overlap+1));
-        mass2.translate( axis * (overlap+1) );
-        // smack!
-        mass1.hit(- I);
-        mass2.hit(I);
-    }
-
-    
-} // end namespace PatternSpace
+/*
+  Implementation for Mass
+
+  Mostly implements a second-order 2D classical physics simulation in the
+naive way.
+
+  Note that the interactions only make use of the Mass interface, and have
+no knowledge of the various implementations.
+  
+*/
+
+#include "mass.h"
+
+namespace PatternSpace {
+    
+/*********************  Mass  *********************/
+    // TODO: use templates to combine these two implementations
+    Mass& Mass::push(const Vector2d force,const Vector2d offset)
+    {
+        push(force);
+        if ( offset.magnitude() > .0001 ) {
+            torque( cross( force, offset) );
+        }
+        return *this;
+    }
+    
+    Mass& Mass::hit(const Vector2d impulse,const Vector2d offset)
+    {
+        hit(impulse);
+        if ( offset.magnitude() > .0001 ) {
+            twist( cross( impulse, offset ) );
+        }
+        return *this;
+    }
+    
+    // moment of a sphere.  (useful default implementation.)
+    // "I have a solution, but it only works for spherical chickens in
+    //  a vaccuum!"
+    double Mass::moment() const 
+    {
+        double r = radius();
+        return (2.0/5.0) * mass() * r*r;
+    }
+
+/*********************  NewtonianMass  *********************/
+    NewtonianMass::NewtonianMass(double mass,
+                                 double moment,
+                                 double radius,
+                                 Vector2d position,
+                                 Vector2d velocity,
+                                 double angle,
+                                 double rotation):
+        slot( pool().allocate() )
+    {
+        MassPool& p = pool();
+        p.m[slot] = mass;
+        p.I[slot] = moment;
+        p.r[slot] = radius;
+        p.px[slot] = position.x();
+        p.py[slot] = position.y();
+        p.vx[slot] = velocity.x();
+        p.vy[slot] = velocity.y();
+        p.a[slot] = angle;
+        p.o[slot] = rotation;
+    }
+            
+    NewtonianMass::NewtonianMass(Mass& rhs):
+        slot( pool().allocate() )
+    {
+        MassPool& p = pool();
+        p.m[slot] = rhs.mass();
+        p.I[slot] = rhs.moment();
+        p.r[slot] = rhs.radius();
+        p.px[slot] = rhs.position().x();
+        p.py[slot] = rhs.position().y();
+        p.vx[slot] = rhs.velocity().x();
+        p.vy[slot] = rhs.velocity().y();
+        p.a[slot] = rhs.angle();
+        p.o[slot] = rhs.rotation();
+    }
+
+    NewtonianMass::NewtonianMass(const NewtonianMass& rhs):
+        slot( pool().allocate() )
+    {
+        copyFrom(rhs);
+    }
+
+    NewtonianMass& NewtonianMass::operator=(const NewtonianMass& rhs)
+    {
+        if ( &rhs != this ) copyFrom(rhs);
+        return *this;
+    }
+
+    NewtonianMass::~NewtonianMass()
+    {
+        pool().release(slot);
+    }
+
+    // copy the whole row, including any subclass columns.
+    void NewtonianMass::copyFrom(const NewtonianMass& rhs)
+    {
+        MassPool& p = pool();
+        int from = rhs.slot;
+        p.m[slot] = p.m[from];
+        p.I[slot] = p.I[from];
+        p.r[slot] = p.r[from];
+        p.px[slot] = p.px[from];
+        p.py[slot] = p.py[from];
+        p.vx[slot] = p.vx[from];
+        p.vy[slot] = p.vy[from];
+        p.a[slot] = p.a[from];
+        p.o[slot] = p.o[from];
+        p.fx[slot] = p.fx[from];
+        p.fy[slot] = p.fy[from];
+        p.ix[slot] = p.ix[from];
+        p.iy[slot] = p.iy[from];
+        p.tsum[slot] = p.tsum[from];
+        p.stsum[slot] = p.stsum[from];
+        p.velocityFriction[slot] = p.velocityFriction[from];
+        p.turnFriction[slot] = p.turnFriction[from];
+        p.linear[slot] = p.linear[from];
+    }
+
+    void NewtonianMass::friction(double velocityFriction, double turnFriction)
+    {
+        pool().velocityFriction[slot] = velocityFriction;
+        pool().turnFriction[slot] = turnFriction;
+    }
+
+    void NewtonianMass::pointForward(bool state)
+    {
+        pool().linear[slot] = state;
+    }
+            
+    Mass& NewtonianMass::translate(const Vector2d deltaPosition) {
+        pool().px[slot] += deltaPosition.x();
+        pool().py[slot] += deltaPosition.y();
+        return *this;
+    }
+    
+    // friction and pointing forward are what kind of Mass this is, so
+    // they stay too.
+    Mass& NewtonianMass::restart(Vector2d position, Vector2d velocity, double angle, double rotation) {
+        MassPool& p = pool();
+        p.px[slot] = position.x();
+        p.py[slot] = position.y();
+        p.vx[slot] = velocity.x();
+        p.vy[slot] = velocity.y();
+        p.a[slot] = angle;
+        p.o[slot] = rotation;
+        p.fx[slot] = p.fy[slot] = 0;
+        p.ix[slot] = p.iy[slot] = 0;
+        p.tsum[slot] = p.stsum[slot] = 0;
+        return *this;
+    }
+
+    Mass& NewtonianMass::push(const Vector2d force) {
+        pool().fx[slot] += force.x();
+        pool().fy[slot] += force.y();
+        return *this;
+    }
+    Mass& NewtonianMass::hit(const Vector2d impulse) {
+        pool().ix[slot] += impulse.x();
+        pool().iy[slot] += impulse.y();
+        return *this;
+    }   
+    Mass& NewtonianMass::torque(double torque) {
+        pool().tsum[slot] += torque;
+        return *this;
+    }
+    Mass& NewtonianMass::twist(double suddenTorque) {
+        pool().stsum[slot] += suddenTorque;
+        return *this;
+    }
+    // the integration itself is done by the pool, possibly later and in a
+    // batch with everyone else.
+    void NewtonianMass::step(double deltaTime) {
+        pool().step(slot, deltaTime);
+    }
+    
+/*********************  Interactions  *********************/
+
+    // applies the gravitational force between two Masses to each.
+    // Effective C++ item 23: prefer non-member non-friends.
+    // F := Force vector on mass1.
+    void gravitate( Mass& mass1, Mass& mass2) {
+        // gameplay kludge.  limit forces very near large masses.
+        double threshold = mass1.radius() > mass2.radius() ?
+                            3 * mass1.radius() :
+                            3 * mass2.radius();
+        Vector2d F = gravity( mass1.position(), mass1.mass(),
+                              mass2.position(), mass2.mass(),
+                              threshold);
+        mass1.push( F );
+        mass2.push( -F );
+    }
+    
+    void collision( Mass& mass1, Mass& mass2 ) {
+        sweptCollision( mass1, mass2, 0 );
+    }
+
+    void sweptCollision( Mass& mass1, Mass& mass2, double sweep ) {
+        Vector2d R = mass2.position() - mass1.position();
+        double r = R.magnitude();
+        double reach = mass1.radius() + mass2.radius();
+        double overlap = reach - r;
+        double impact = 0;
+        if ( overlap < 0 ) {
+            // will they touch before the step is out?  If so, bounce them
+            // off each other as they'll be then.
+            if ( sweep == 0 ) return;
+            Vector2d V = ( mass2.velocity() - mass1.velocity() ) * sweep;
+            double t = timeOfImpact( R.x(), R.y(), V.x(), V.y(), reach );
+            if ( t > 1 ) return;
+            impact = t * sweep;
+            R = R + V * t;
+            overlap = 0;
+        }
+        Vector2d axis = R.unit();
+        
+        // calculate the velocity of the center of mass along the axis.
+        double p1 = dot( mass1.velocity(), axis) * mass1.mass();
+        double p2 = dot( mass2.velocity(), axis) * mass2.mass();
+        double vc = ( p1 + p2) /( mass1.mass() + mass2.mass() );
+        
+        // applying this impulse will reverse the mass1 relative to the center
+        // of mass, i.e. an elastic collision.
+        double impulse = 2*( p1 - vc * mass1.mass());
+        bounce( mass1, mass2, axis, overlap, impulse, impact);
+    }
+
+    void bounce( Mass& mass1, Mass& mass2, Vector2d axis, double overlap, double impulse, double impact) {
+        // Impulse Vector
+        Vector2d I = axis * impulse;
+
+        // ok, we're ready to do the actual collision.  Before we do, we
+        // move the two masses so they don't overlap.  The +1 adds one pixel
+        // of padding.
+        if ( impact == 0 ) {
+            mass1.translate( -axis * (overlap+1));
+            mass2.translate( axis * (overlap+1) );
+        } else {
+            // they haven't met yet.  The step will move them the whole way
+            // at their new velocities, so make up the difference for the
+            // part of the way they travel at the old ones.
+            mass1.translate( I * ( impact / mass1.mass() ) );
+            mass2.translate( -I * ( impact / mass2.mass() ) );
+        }
+        // smack!
+        mass1.hit(- I);
+        mass2.hit(I);
+    }
+
+    
+} // end namespace PatternSpace
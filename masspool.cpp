@@ -0,0 +1,159 @@
+/*
+  Implementation for MassPool
+
+  integrate() is written as straight-line arithmetic over the columns, with
+the scheduled flag (1 or 0) multiplied into each update rather than used to
+skip a slot.  That gives the compiler loops with no branches in them, which it
+can vectorize.  Multiplying by one is exact, so a scheduled slot gets exactly
+the same answer as the old per-object step().  The fmod() calls in clean()
+can't be vectorized anyway, so they get an ordinary loop.
+
+*/
+
+#include <math.h>
+
+#include "masspool.h"
+#include "mass.h"
+
+namespace PatternSpace {
+
+/*********************  MassPool  *********************/
+    MassPool MassPool::pool;
+
+    MassPool::MassPool():
+        deferSteps(false)
+    {}
+
+    int MassPool::allocate()
+    {
+        int slot;
+        if ( !freeSlots.empty() ) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            slot = int( m.size() );
+            m.push_back(0); I.push_back(0); r.push_back(0);
+            px.push_back(0); py.push_back(0);
+            vx.push_back(0); vy.push_back(0);
+            a.push_back(0); o.push_back(0);
+            fx.push_back(0); fy.push_back(0);
+            ix.push_back(0); iy.push_back(0);
+            tsum.push_back(0); stsum.push_back(0);
+            velocityFriction.push_back(0); turnFriction.push_back(0);
+            scheduled.push_back(0);
+            linear.push_back(0);
+        }
+        m[slot] = I[slot] = r[slot] = 0;
+        px[slot] = py[slot] = vx[slot] = vy[slot] = 0;
+        a[slot] = o[slot] = 0;
+        fx[slot] = fy[slot] = ix[slot] = iy[slot] = 0;
+        tsum[slot] = stsum[slot] = 0;
+        velocityFriction[slot] = turnFriction[slot] = 0;
+        scheduled[slot] = 0;
+        linear[slot] = 0;
+        return slot;
+    }
+
+    void MassPool::release(int slot)
+    {
+        // keep the divisions in integrate() harmless for free slots.
+        m[slot] = I[slot] = 1;
+        scheduled[slot] = 0;
+        freeSlots.push_back(slot);
+    }
+
+    MassPool& MassPool::defer(bool state)
+    {
+        deferSteps = state;
+        return *this;
+    }
+
+    void MassPool::step(int slot, double deltaTime)
+    {
+        scheduled[slot] = 1;
+        if ( !deferSteps ) {
+            integrate(slot, slot + 1, deltaTime);
+            clean(slot, slot + 1);
+        }
+    }
+
+    MassPool& MassPool::stepAll(double deltaTime)
+    {
+        integrate(0, int( m.size() ), deltaTime);
+        clean(0, int( m.size() ));
+        return *this;
+    }
+
+    // advance velocity and position by the accumulated forces.  This is
+    // NewtonianMass::step() and FrictionMass's friction, one column at a time.
+    //
+    // Each loop only writes one column, which keeps the number of aliasing
+    // checks the compiler has to make small enough that it will vectorize.
+    // Friction is zero for everyone but FrictionMass, and adding a zero
+    // doesn't change anything, so there's no need to check for it.
+    void MassPool::integrate(int first, int last, double deltaTime)
+    {
+        if ( first >= last ) return;
+
+        const double* mass = &m[0];
+        const double* moment = &I[0];
+        const double* stepping = &scheduled[0];  // 1 to step, 0 to leave alone
+        double* velocityX = &vx[0];
+        double* velocityY = &vy[0];
+        double* omega = &o[0];
+        int i;
+
+        const double* force = &fx[0];
+        const double* impulse = &ix[0];
+        const double* drag = &velocityFriction[0];
+        for( i = first; i < last; i++ ) {
+            double F = ( force[i] * deltaTime + impulse[i] ) + ( velocityX[i] * (-drag[i] * deltaTime) ) * mass[i];
+            velocityX[i] += stepping[i] * ( F * (1.0 / mass[i]) );
+        }
+        force = &fy[0];
+        impulse = &iy[0];
+        for( i = first; i < last; i++ ) {
+            double F = ( force[i] * deltaTime + impulse[i] ) + ( velocityY[i] * (-drag[i] * deltaTime) ) * mass[i];
+            velocityY[i] += stepping[i] * ( F * (1.0 / mass[i]) );
+        }
+
+        // velocities are per REFERENCE_STEP, so this is exactly one when
+        // stepping at the reference rate.
+        double travel = deltaTime / REFERENCE_STEP;
+        double* position = &px[0];
+        for( i = first; i < last; i++ ) {
+            position[i] += stepping[i] * ( velocityX[i] * travel );
+        }
+        position = &py[0];
+        for( i = first; i < last; i++ ) {
+            position[i] += stepping[i] * ( velocityY[i] * travel );
+        }
+
+        const double* torque = &tsum[0];
+        const double* suddenTorque = &stsum[0];
+        const double* turnDrag = &turnFriction[0];
+        for( i = first; i < last; i++ ) {
+            double T = ( torque[i] * deltaTime + suddenTorque[i] ) + ( (-turnDrag[i] * deltaTime) * omega[i] ) * moment[i];
+            omega[i] += stepping[i] * ( T / moment[i] );
+        }
+        double* angle = &a[0];
+        for( i = first; i < last; i++ ) {
+            angle[i] += stepping[i] * ( omega[i] * travel );
+        }
+    }
+
+    // clear the applied forces and clean up the angles of stepped slots.
+    void MassPool::clean(int first, int last)
+    {
+        for( int i = first; i < last; i++ ) {
+            if ( !scheduled[i] ) continue;
+            fx[i] = fy[i] = 0;
+            ix[i] = iy[i] = 0;
+            tsum[i] = stsum[i] = 0;
+            a[i] = fmod(a[i], 360);
+            o[i] = fmod(o[i], 360);
+            scheduled[i] = 0;
+        }
+    }
+
+} // end namespace PatternSpace
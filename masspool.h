@@ -0,0 +1,90 @@
+/*
+  MassPool
+
+  MassPool is the backing store for NewtonianMass and its subclasses.  Rather
+than each Mass being its own little heap object, every physical property
+lives in a contiguous array (a column) with one entry (a slot) per Mass, so
+a NewtonianMass is just a handle holding its slot number.
+
+  The point is stepAll(): instead of a virtual step() call per object, each
+chasing its own pointer, the whole pool is integrated in one linear pass
+over the columns.  That's friendly to the cache, and the inner loop is simple
+enough for the compiler to vectorize.
+
+  The properties that used to distinguish the subclasses are columns too:
+FrictionMass just fills in the friction coefficients (which are zero for
+everyone else), and LinearMass sets the linear flag.
+
+Usage:
+  The Universe turns on defer() around its step loop.  While deferring,
+NewtonianMass::step() only schedules its slot, so everything a Solid does in
+its own step() (aging, applying thrust, and so on) still happens in the same
+order.  Then stepAll() integrates every scheduled slot at once.  When not
+deferring, step() integrates the one slot immediately, exactly as before.
+
+  The arithmetic in both paths is the same as the original per-object
+NewtonianMass::step(), down to the order of operations, so the results are
+identical.
+
+  Note: allocate() and release() may move the columns, so they must not run
+while another thread is reading a Mass.  Only the physics thread touches the
+Masses; the painter draws from the Universe's snapshots.
+
+*/
+#ifndef PATTERN_SPACE_MASSPOOL_INCLUSION_GUARD
+#define PATTERN_SPACE_MASSPOOL_INCLUSION_GUARD
+
+#include <vector>
+
+namespace PatternSpace {
+
+/*********************  MassPool  *********************/
+    class MassPool {
+    public:
+        // the pool shared by all NewtonianMasses.
+        static MassPool& instance() { return pool; }
+
+        int allocate();           // returns a zeroed slot
+        void release(int slot);
+
+        // integrate one slot now, or schedule it while deferring.
+        void step(int slot, double deltaTime);
+
+        MassPool& defer(bool);
+        bool deferring() const { return deferSteps; }
+        // integrate every scheduled slot in one pass.
+        MassPool& stepAll(double deltaTime);
+
+        int size() const { return int(m.size() - freeSlots.size()); }
+
+    private:
+        friend class NewtonianMass;
+
+        MassPool();
+        void integrate(int first, int last, double deltaTime);
+        void clean(int first, int last);
+
+        static MassPool pool;
+
+        bool deferSteps;
+        std::vector<int> freeSlots;
+
+        // one column per property; see NewtonianMass for the notation.
+        std::vector<double> m, I, r;
+        std::vector<double> px, py;
+        std::vector<double> vx, vy;
+        std::vector<double> a, o;
+        std::vector<double> fx, fy;     // total force
+        std::vector<double> ix, iy;     // total impulse
+        std::vector<double> tsum, stsum;
+        std::vector<double> velocityFriction, turnFriction;
+        std::vector<double> scheduled;  // 1 if waiting for stepAll(), else 0
+        std::vector<char> linear;       // points where it's going
+
+        // prevent copying or assignment
+        MassPool& operator=(MassPool&);
+        MassPool(MassPool&);
+    }; // end class MassPool
+
+} // end namespace PatternSpace
+#endif // PATTERN_SPACE_MASSPOOL_INCLUSION_GUARD
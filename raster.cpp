@@ -0,0 +1,175 @@
+/*
+  Implementation for Raster
+
+  The blits are clipped to the target when they're queued, exactly as
+SDL_UpperBlit clips them, so the bands only ever have to clip to their own
+rows.  A band draws the rows of each of its blits that fall within it, and
+nothing else, so no two tasks ever write to the same pixel, and the sources
+are only read.
+
+  A color-keyed blit copies every pixel that isn't the key, comparing the
+color bits only, as SDL does, a row at a time with keyedCopy().  A source
+without a key is just copied.
+
+*/
+#include <string.h>
+#include <algorithm>
+
+#include "raster.h"
+#include "kernels.h"
+
+namespace PatternSpace {
+
+/*********************  BandJob  *********************/
+    class Raster::BandJob : public TaskPool::Job {
+    public:
+        explicit BandJob(Raster& r): raster(r) {}
+        void run(int task)
+        {
+            int top = task * raster.bandHeight;
+            raster.drawBand( top, top + raster.bandHeight, raster.binned[task] );
+        }
+    private:
+        Raster& raster;
+    };
+
+/*********************  Raster  *********************/
+    Raster::Raster(int threads, int bands):
+        pool( new TaskPool(threads) ), bandCount(bands), serial(false), target(0), bandHeight(0)
+    {
+        if ( bandCount < 1 ) bandCount = 4 * pool->threads();
+        binned.resize(bandCount);
+        counts.frames = counts.blits = counts.binned = counts.serial = 0;
+    }
+
+    Raster::~Raster() {}
+
+    int Raster::threads() const
+    {
+        return pool->threads();
+    }
+
+    int Raster::bands() const
+    {
+        return bandCount;
+    }
+
+    const Raster::Stats& Raster::stats() const
+    {
+        return counts;
+    }
+
+    bool Raster::clip(const SDL_Surface* source, SDL_Rect& at, const SDL_Surface* target,
+                      int& sourceX, int& sourceY)
+    {
+        sourceX = sourceY = 0;
+        int x = at.x, y = at.y, w = source->w, h = source->h;
+        const SDL_Rect& clip = target->clip_rect;
+        if ( x < clip.x ) {
+            sourceX = clip.x - x;
+            w -= clip.x - x;
+            x = clip.x;
+        }
+        if ( y < clip.y ) {
+            sourceY = clip.y - y;
+            h -= clip.y - y;
+            y = clip.y;
+        }
+        if ( x + w > clip.x + clip.w ) w = clip.x + clip.w - x;
+        if ( y + h > clip.y + clip.h ) h = clip.y + clip.h - y;
+        if ( w <= 0 || h <= 0 ) {
+            at.w = at.h = 0;
+            return false;
+        }
+        at.x = x;
+        at.y = y;
+        at.w = w;
+        at.h = h;
+        return true;
+    }
+
+    bool Raster::copyable(const SDL_Surface* source, const SDL_Surface* target)
+    {
+        const SDL_PixelFormat* from = source->format;
+        const SDL_PixelFormat* to = target->format;
+        if ( from->BytesPerPixel != 4 || to->BytesPerPixel != 4
+             || from->Rmask != to->Rmask || from->Gmask != to->Gmask
+             || from->Bmask != to->Bmask || from->Amask != to->Amask
+             || ( source->flags & ( SDL_SRCALPHA | SDL_RLEACCEL ) ) ) {
+            return false;
+        }
+        return source->pixels != 0;
+    }
+
+    void Raster::copy(const SDL_Surface* source, int sourceX, int sourceY,
+                      SDL_Surface* target, const SDL_Rect& at, int top, int bottom)
+    {
+        int first = std::max( int(at.y), top );
+        int last = std::min( at.y + at.h, bottom );
+        bool keyed = ( source->flags & SDL_SRCCOLORKEY ) != 0;
+        Uint32 mask = ~source->format->Amask;
+        Uint32 key = source->format->colorkey & mask;
+        for( int y = first; y < last; y++ ) {
+            const Uint32* from = reinterpret_cast<const Uint32*>(
+                static_cast<const Uint8*>(source->pixels) + ( sourceY + y - at.y ) * source->pitch ) + sourceX;
+            Uint32* to = reinterpret_cast<Uint32*>( static_cast<Uint8*>(target->pixels) + y * target->pitch ) + at.x;
+            if ( keyed ) {
+                keyedCopy( at.w, from, to, key, mask );
+            } else {
+                memcpy( to, from, at.w * sizeof(Uint32) );
+            }
+        }
+    }
+
+    void Raster::queue(SDL_Surface* source, SDL_Rect& at, SDL_Surface* target)
+    {
+        Blit blit;
+        blit.source = source;
+        if ( !clip( source, at, target, blit.sourceX, blit.sourceY ) ) return;
+        blit.at = at;
+        if ( !copyable( source, target ) ) serial = true;
+        blits.push_back(blit);
+    }
+
+    void Raster::render(SDL_Surface* target)
+    {
+        counts.frames++;
+        counts.blits += blits.size();
+        if ( serial ) {
+            for( size_t i = 0; i < blits.size(); i++ ) {
+                SDL_Rect from = { Sint16( blits[i].sourceX ), Sint16( blits[i].sourceY ), blits[i].at.w, blits[i].at.h };
+                SDL_Rect to = blits[i].at;
+                SDL_BlitSurface(blits[i].source, &from, target, &to);
+            }
+            counts.serial++;
+        } else if ( !blits.empty() ) {
+            bandHeight = ( target->h + bandCount - 1 ) / bandCount;
+            for( int band = 0; band < bandCount; band++ ) binned[band].clear();
+            for( size_t i = 0; i < blits.size(); i++ ) {
+                const SDL_Rect& at = blits[i].at;
+                int last = ( at.y + at.h - 1 ) / bandHeight;
+                for( int band = at.y / bandHeight; band <= last; band++ ) {
+                    binned[band].push_back( int(i) );
+                    counts.binned++;
+                }
+            }
+            bool locked = SDL_MUSTLOCK(target) && SDL_LockSurface(target) == 0;
+            this->target = target;
+            BandJob job(*this);
+            pool->run( job, bandCount );
+            this->target = 0;
+            if ( locked ) SDL_UnlockSurface(target);
+        }
+        blits.clear();
+        serial = false;
+    }
+
+    void Raster::drawBand(int top, int bottom, const std::vector<int>& indices)
+    {
+        for( size_t i = 0; i < indices.size(); i++ ) {
+            const Blit& blit = blits[ indices[i] ];
+            copy( blit.source, blit.sourceX, blit.sourceY, target, blit.at, top, bottom );
+        }
+    }
+
+} // end namespace PatternSpace
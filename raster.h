@@ -0,0 +1,107 @@
+/*
+  Raster
+
+  A frame is drawn one blit after another on the painter's thread, and with
+enough sprites on the screen that one thread can't keep up, however many
+cores are sitting idle.  A Raster takes the blits of a frame as they're
+made, and draws them all at the end, in horizontal bands of the target, a
+TaskPool task to each band.  Each blit is binned into every band it
+overlaps, and each band draws its blits in the order they were made,
+clipped to its own rows, so every pixel comes out just as if they'd been
+drawn one after another.
+
+  SDL's blitters can't be run on several threads at once: a source
+remembers the mapping to the last surface it was blitted onto, and
+blitting it onto anything else rebuilds it.  So the bands are drawn with
+a color-keyed copy of 32-bit pixels instead (keyedCopy() in kernels.h).
+That only handles sources in the target's own format, without alpha, and
+not RLE encoded, since the copy reads the pixels themselves.  That's
+everything the ImageStore and the RotationCache make: Surface::rotatedBy()
+converts rotozoomSurface()'s RGBA back, and Surface::keyBlack() only RLE
+encodes when blitPath() leaves the blitting to SDL.  If anything else
+turns up, the whole frame is drawn with SDL, in order, on the calling
+thread.
+
+Usage:
+  queue() each blit with where it goes on the target, as SDL_BlitSurface
+takes it; like SDL_BlitSurface, it clips the rectangle and writes back
+where the blit will land.  Then render() them all onto the target.  The
+sources must stay put until render() returns (see RotationCache::hold()),
+and nothing else should draw on the target in between.
+
+  clip(), copyable() and copy() are the pieces of a single blit, for
+drawing one on the spot the same way; see Surface::blit().
+
+*/
+#ifndef PATTERN_SPACE_RASTER_INCLUSION_GUARD
+#define PATTERN_SPACE_RASTER_INCLUSION_GUARD
+
+#include <memory>
+#include <vector>
+#include <SDL/SDL.h>
+
+#include "taskpool.h"
+
+namespace PatternSpace {
+
+/*********************  Raster  *********************/
+    class Raster {
+    public:
+        // counted over every render().
+        struct Stats {
+            unsigned long frames;
+            unsigned long blits;
+            unsigned long binned;       // blits times the bands they're in
+            unsigned long serial;       // frames drawn with SDL instead
+        };
+
+        // bands of zero means four for each thread.
+        explicit Raster(int threads, int bands = 0);
+        ~Raster();
+
+        int threads() const;
+        int bands() const;
+
+        void queue(SDL_Surface* source, SDL_Rect& at, SDL_Surface* target);
+        void render(SDL_Surface* target);
+
+        const Stats& stats() const;
+
+        // clip at to target as SDL_BlitSurface would, and say where in the
+        // source the part that's left starts; false if nothing is.
+        static bool clip(const SDL_Surface* source, SDL_Rect& at, const SDL_Surface* target,
+                         int& sourceX, int& sourceY);
+        // whether copy() can draw source onto target.
+        static bool copyable(const SDL_Surface* source, const SDL_Surface* target);
+        // the rows from top to bottom of a clipped blit.
+        static void copy(const SDL_Surface* source, int sourceX, int sourceY,
+                         SDL_Surface* target, const SDL_Rect& at, int top, int bottom);
+
+    private:
+        struct Blit {
+            SDL_Surface* source;
+            int sourceX, sourceY;     // of the part that lands, after clipping
+            SDL_Rect at;
+        };
+        class BandJob;
+        friend class BandJob;
+
+        // the rows of the target between top and bottom.
+        void drawBand(int top, int bottom, const std::vector<int>& blits);
+
+        std::auto_ptr<TaskPool> pool;
+        int bandCount;
+        std::vector<Blit> blits;
+        std::vector< std::vector<int> > binned;   // blits by band
+        bool serial;                  // something queued that only SDL can draw
+        SDL_Surface* target;          // while rendering
+        int bandHeight;
+        Stats counts;
+
+        // prevent copying or assignment
+        Raster& operator=(Raster&);
+        Raster(Raster&);
+    }; // end class Raster
+
+} // end namespace PatternSpace
+#endif  // PATTERN_SPACE_RASTER_INCLUSION_GUARD
@@ -0,0 +1,177 @@
+/*
+  SlotMap
+
+  A SlotMap is a container that hands out a Handle for everything put into
+it, and keeps the things themselves packed together in a vector, so going
+through them all is as fast as going through an array.  A Handle stays good
+until its value is erased, whatever else comes and goes, and after that it
+is simply stale: find() returns 0 for it, even if the space has been reused
+since, because every reuse bumps the space's generation.
+
+  Values are moved around with swap(), never copied, so a SlotMap of
+shared_ptrs doesn't touch the reference counts to do it.
+
+  insert() and erase() are O(1).  erase() fills the gap with the last value,
+so it changes the order.  eraseIf() erases everything matching a predicate
+in one O(n) pass, and keeps the rest in order, which is the one to use when
+the order matters.  There's also a bulk insert(), which makes room for
+everything up front, for loading large scenes.
+
+Usage:
+  The values are in dense order from 0 to size()-1; use operator[] or
+begin() and end() to go through them, and handle() to get the Handle of the
+value at a given place.  Inserting may move the values, so don't hold on to
+references or iterators across an insert(); indices are fine, though, since
+new values always go on the end.
+
+*/
+#ifndef PATTERN_SPACE_SLOTMAP_INCLUSION_GUARD
+#define PATTERN_SPACE_SLOTMAP_INCLUSION_GUARD
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+namespace PatternSpace {
+
+/*********************  SlotMap  *********************/
+    template <class T>
+    class SlotMap {
+    public:
+        struct Handle {
+            Handle(): slot(NONE), generation(0) {}
+            unsigned slot;
+            unsigned generation;
+            bool operator==(const Handle& other) const { return slot == other.slot && generation == other.generation; }
+            bool operator!=(const Handle& other) const { return !( *this == other ); }
+        };
+        typedef typename std::vector<T>::iterator iterator;
+        typedef typename std::vector<T>::const_iterator const_iterator;
+
+        Handle insert(const T& value)
+        {
+            unsigned slot;
+            if ( freeSlots.empty() ) {
+                slot = unsigned( slots.size() );
+                slots.push_back( Slot() );
+            } else {
+                slot = freeSlots.back();
+                freeSlots.pop_back();
+            }
+            slots[slot].dense = unsigned( values.size() );
+            values.push_back(value);
+            owners.push_back(slot);
+
+            Handle handle;
+            handle.slot = slot;
+            handle.generation = slots[slot].generation;
+            return handle;
+        }
+
+        // everything from first to last (forward iterators), with their
+        // Handles appended to handles if it isn't 0.
+        template <class ForwardIterator>
+        void insert(ForwardIterator first, ForwardIterator last, std::vector<Handle>* handles = 0)
+        {
+            size_t count = std::distance( first, last );
+            reserve( values.size() + count );
+            if ( handles ) handles->reserve( handles->size() + count );
+            for( ; first != last; ++first ) {
+                Handle handle = insert(*first);
+                if ( handles ) handles->push_back(handle);
+            }
+        }
+
+        // false if the Handle was already stale.
+        bool erase(Handle handle)
+        {
+            if ( !contains(handle) ) return false;
+            unsigned dense = slots[handle.slot].dense;
+            unsigned last = unsigned( values.size() - 1 );
+            if ( dense != last ) {
+                using std::swap;
+                swap( values[dense], values[last] );
+                owners[dense] = owners[last];
+                slots[ owners[dense] ].dense = dense;
+            }
+            values.pop_back();
+            owners.pop_back();
+            release( handle.slot );
+            return true;
+        }
+
+        // erase every value for which erased(value) is true, keeping the
+        // rest in order.  Returns how many were erased.
+        template <class Predicate>
+        size_t eraseIf(Predicate erased)
+        {
+            using std::swap;
+            size_t kept = 0;
+            for( size_t i = 0; i < values.size(); i++ ) {
+                if ( erased( values[i] ) ) {
+                    release( owners[i] );
+                    continue;
+                }
+                if ( kept != i ) {
+                    swap( values[kept], values[i] );
+                    owners[kept] = owners[i];
+                }
+                slots[ owners[kept] ].dense = unsigned(kept);
+                kept++;
+            }
+            size_t count = values.size() - kept;
+            values.erase( values.begin() + kept, values.end() );
+            owners.resize( kept );
+            return count;
+        }
+
+        bool contains(Handle handle) const
+        {
+            return handle.slot < slots.size() && slots[handle.slot].generation == handle.generation
+                && slots[handle.slot].dense != NONE;
+        }
+        // the value, or 0 if the Handle is stale.
+        T* find(Handle handle) { return contains(handle) ? &values[ slots[handle.slot].dense ] : 0; }
+        const T* find(Handle handle) const { return contains(handle) ? &values[ slots[handle.slot].dense ] : 0; }
+
+        // dense access
+        size_t size() const { return values.size(); }
+        bool empty() const { return values.empty(); }
+        void reserve(size_t count) { values.reserve(count); owners.reserve(count); }
+        T& operator[](size_t i) { return values[i]; }
+        const T& operator[](size_t i) const { return values[i]; }
+        Handle handle(size_t i) const
+        {
+            Handle handle;
+            handle.slot = owners[i];
+            handle.generation = slots[ owners[i] ].generation;
+            return handle;
+        }
+        iterator begin() { return values.begin(); }
+        iterator end() { return values.end(); }
+        const_iterator begin() const { return values.begin(); }
+        const_iterator end() const { return values.end(); }
+
+    private:
+        static const unsigned NONE = ~0u;   // no slot, or no value
+        struct Slot {
+            Slot(): dense(NONE), generation(0) {}
+            unsigned dense;         // where the value is, or NONE if free
+            unsigned generation;    // bumped every time the slot is freed
+        };
+
+        void release(unsigned slot)
+        {
+            slots[slot].dense = NONE;
+            slots[slot].generation++;
+            freeSlots.push_back(slot);
+        }
+
+        std::vector<T> values;
+        std::vector<unsigned> owners;   // the slot of each value
+        std::vector<Slot> slots;
+        std::vector<unsigned> freeSlots;
+    }; // end class SlotMap
+
+} // end namespace PatternSpace
+#endif  // PATTERN_SPACE_SLOTMAP_INCLUSION_GUARD
@@ -1,32 +1,49 @@
-/*
-  Implementation for NormalSolid
-  
-  NormalSolid mostly just delegates, so is mostly defined inline in solid.h.
-The new behavior defined here keeps track of age and damage.
-
-*/
-
-#include "solid.h"
-#include "universe.h"
-#include "factories.h"
-
-namespace PatternSpace {
-    
-/*********************  NormalSolid  *********************/
-    void NormalSolid::die() { dead = true; }
-    
-    Mass& NormalSolid::hit(const Vector2d impulse)
-    { 
-        damage += impulse.magnitude();
-        if (hitPoints && damage > hitPoints) die();
-        return pMass->hit(impulse);
-    }
-
-    void NormalSolid::step(double deltaTime)
-    { 
-        age += 1;
-        if (life && (age>life) ) die();
-        pMass->step(deltaTime);
-    }
-        
-} // end namespace PatternSpace
+/*
+  Implementation for NormalSolid
+  
+  NormalSolid mostly just delegates, so is mostly defined inline in solid.h.
+The new behavior defined here keeps track of age and damage, and remembers
+where the Solid was before each step so that it can be drawn in between.
+
+*/
+
+#include "solid.h"
+#include "universe.h"
+#include "factories.h"
+
+namespace PatternSpace {
+    
+/*********************  NormalSolid  *********************/
+    void NormalSolid::die() { dead = true; }
+    
+    Mass& NormalSolid::hit(const Vector2d impulse)
+    { 
+        damage += impulse.magnitude();
+        if (hitPoints && damage > hitPoints) die();
+        return pMass->hit(impulse);
+    }
+
+    Mass& NormalSolid::restart(Vector2d position, Vector2d velocity, double angle, double rotation)
+    {
+        pMass->restart(position, velocity, angle, rotation);
+        dead = false;
+        damage = 0;
+        age = 0;
+        resetDetail();
+        pImage->rewind();
+        lastPosition = this->position();
+        lastAngle = this->angle();
+        return *this;
+    }
+
+    void NormalSolid::step(double deltaTime)
+    { 
+        // life is counted in reference steps
+        age += deltaTime / REFERENCE_STEP;
+        if (life && (age>life) ) die();
+        lastPosition = position();
+        lastAngle = angle();
+        pMass->step(deltaTime);
+    }
+        
+} // end namespace PatternSpace
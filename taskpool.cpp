@@ -0,0 +1,144 @@
+/*
+  Implementation for TaskPool
+
+  Each Worker's queue has its own Resource, so the only time two threads
+contend for a lock is when one of them is stealing.  The owner takes tasks
+from the front, thieves from the back, so a thief takes the work its owner
+would have got to last.
+
+  Nothing is added to the queues while a job is running, so a thread that
+finds every queue empty can stop: whatever is left is already being worked
+on.  The semaphores the threads wake and finish on also make sure they see
+each other's writes.
+
+*/
+#include "taskpool.h"
+
+namespace PatternSpace {
+
+/*********************  TaskPool  *********************/
+    TaskPool::TaskPool(int threads):
+        finished(0), job(0), phase(0), stopping(false)
+    {
+        if ( threads < 1 ) threads = 1;
+        for( int i = 0; i < threads; i++ ) {
+            Worker* pWorker = new Worker;
+            pWorker->pool = this;
+            pWorker->index = i;
+            workers.push_back(pWorker);
+        }
+        // worker zero is whoever calls run().
+        for( int i = 1; i < threads; i++ ) {
+            workers[i]->thread = SDL_CreateThread( work, workers[i] );
+        }
+    }
+
+    TaskPool::~TaskPool()
+    {
+        stopping = true;
+        for( size_t i = 1; i < workers.size(); i++ ) {
+            workers[i]->wake.post();
+        }
+        for( size_t i = 0; i < workers.size(); i++ ) {
+            if ( workers[i]->thread ) SDL_WaitThread( workers[i]->thread, 0 );
+            delete workers[i];
+        }
+    }
+
+    int TaskPool::threads() const
+    {
+        return int(workers.size());
+    }
+
+    int TaskPool::steals() const
+    {
+        int total = 0;
+        for( size_t i = 0; i < workers.size(); i++ ) {
+            total += workers[i]->steals;
+        }
+        return total;
+    }
+
+    void TaskPool::run(Job& newJob, int count)
+    {
+        int n = int(workers.size());
+        for( int i = 0; i < n; i++ ) {
+            workers[i]->steals = 0;
+        }
+        if ( n == 1 ) {
+            for( int task = 0; task < count; task++ ) {
+                newJob.run(task);
+            }
+            return;
+        }
+
+        // contiguous runs, so neighbouring tasks tend to share a thread.
+        job = &newJob;
+        phase = LockPhase::active();
+        for( int i = 0; i < n; i++ ) {
+            Lock lock( workers[i]->lock );
+            for( int task = count * i / n; task < count * (i+1) / n; task++ ) {
+                workers[i]->tasks.push_back(task);
+            }
+        }
+        for( int i = 1; i < n; i++ ) {
+            workers[i]->wake.post();
+        }
+        drain(0);
+        for( int i = 1; i < n; i++ ) {
+            finished.wait();
+        }
+        job = 0;
+    }
+
+    // the loop each helper thread runs until the pool is destroyed.
+    int TaskPool::work(void* pWorker)
+    {
+        Worker& worker = *static_cast<Worker*>(pWorker);
+        TaskPool& pool = *worker.pool;
+        while ( true ) {
+            worker.wake.wait();
+            if ( pool.stopping ) break;
+            LockPhase::activate(pool.phase);
+            pool.drain(worker.index);
+            LockPhase::activate(0);
+            pool.finished.post();
+        }
+        return 0;
+    }
+
+    void TaskPool::drain(int self)
+    {
+        int task;
+        while ( next(self, task) ) {
+            job->run(task);
+        }
+    }
+
+    // take a task from our own queue, or failing that, steal one.
+    bool TaskPool::next(int self, int& task)
+    {
+        int n = int(workers.size());
+        {
+            Worker& own = *workers[self];
+            Lock lock( own.lock );
+            if ( !own.tasks.empty() ) {
+                task = own.tasks.front();
+                own.tasks.pop_front();
+                return true;
+            }
+        }
+        for( int k = 1; k < n; k++ ) {
+            Worker& victim = *workers[ (self + k) % n ];
+            Lock lock( victim.lock );
+            if ( !victim.tasks.empty() ) {
+                task = victim.tasks.back();
+                victim.tasks.pop_back();
+                workers[self]->steals++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+} // end namespace PatternSpace
@@ -0,0 +1,83 @@
+/*
+  TaskPool
+
+  A TaskPool keeps a few SDL threads around to share out the work of a
+single step.  The work is a Job: a batch of tasks numbered from zero, each of
+which can run on any thread and in any order.  run() deals the tasks out to
+the threads in contiguous runs, wakes them up, works on its own share on the
+calling thread, and returns once every task is done.
+
+  A thread that finishes its own share steals from the back of another
+thread's queue, so one slow run of tasks doesn't hold up the whole step.
+Since a task may end up on any thread, tasks shouldn't share anything they
+write to.  Anything that has to be added up should go into per-task space
+and be reduced after run() returns, in task order, which makes the answer
+the same no matter how many threads did the work.
+
+  The helpers record their lock statistics into whatever LockPhase the
+thread calling run() is in.
+
+  A TaskPool of one thread doesn't start any threads; run() just runs the
+tasks in order.
+
+*/
+#ifndef PATTERN_SPACE_TASKPOOL_INCLUSION_GUARD
+#define PATTERN_SPACE_TASKPOOL_INCLUSION_GUARD
+
+#include <deque>
+#include <vector>
+#include <SDL/SDL_thread.h>
+
+#include "lock.h"
+
+namespace PatternSpace {
+
+/*********************  TaskPool  *********************/
+    class TaskPool {
+    public:
+        class Job {
+        public:
+            virtual ~Job() {}
+            virtual void run(int task) = 0;
+        };
+
+        // threads counts the calling thread, so TaskPool(4) starts three.
+        explicit TaskPool(int threads);
+        ~TaskPool();
+
+        int threads() const;
+        // run job.run(0) through job.run(count-1), and wait for all of them.
+        void run(Job& job, int count);
+        // tasks that were stolen from another thread's queue during the
+        // last run().
+        int steals() const;
+
+    private:
+        struct Worker {
+            Worker(): wake(0), steals(0), thread(0) {}
+            std::deque<int> tasks;
+            SpinResource lock;        // for tasks
+            SemaphoreResource wake;   // posted when there's a job, or time to quit
+            int steals;
+            SDL_Thread* thread;
+            TaskPool* pool;
+            int index;
+        };
+
+        static int work(void* pWorker);
+        void drain(int self);
+        bool next(int self, int& task);
+
+        std::vector<Worker*> workers;
+        SemaphoreResource finished;   // posted by each helper when it runs out of work
+        Job* job;
+        LockStats* phase;             // the caller's LockPhase, for the helpers
+        bool stopping;
+
+        // prevent copying or assignment
+        TaskPool& operator=(TaskPool&);
+        TaskPool(TaskPool&);
+    }; // end class TaskPool
+
+} // end namespace PatternSpace
+#endif  // PATTERN_SPACE_TASKPOOL_INCLUSION_GUARD
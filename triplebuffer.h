@@ -0,0 +1,74 @@
+/*
+  TripleBuffer
+
+  A TripleBuffer hands data from one thread to another without either of
+them ever waiting for the other.  There are three copies of the data: one
+the writer is filling in, one the reader is using, and one in the middle
+holding the latest complete copy.  When the writer is done it publish()es,
+swapping its copy with the middle one.  When the reader wants the latest, it
+read()s, which swaps the middle copy with its own if there's been a
+publish() since last time.  The swaps are single atomic exchanges on a small
+integer, so there's no lock, and since each side only ever touches its own
+copy, the reader never sees a half written one.
+
+  If the writer publishes several times between reads, the reader just gets
+the latest; the ones in between are lost.  If the reader reads faster than
+the writer publishes, it keeps getting the same copy.
+
+  This uses GCC's __atomic builtins (GCC 4.7 or later.)
+
+Usage:
+  One thread fills in write() and then calls publish().  Another calls
+read().  Never more than one of each.  The copies are reused, so a writer
+should overwrite everything it cares about every time.
+
+*/
+#ifndef PATTERN_SPACE_TRIPLEBUFFER_INCLUSION_GUARD
+#define PATTERN_SPACE_TRIPLEBUFFER_INCLUSION_GUARD
+
+namespace PatternSpace {
+
+/*********************  TripleBuffer  *********************/
+    template <class T>
+    class TripleBuffer {
+    public:
+        TripleBuffer(): back(0), middle(1), front(2) {}
+
+        // the writer's copy.
+        T& write() { return buffers[back]; }
+
+        // make the writer's copy the latest, and give the writer the old
+        // middle copy to fill in next.
+        void publish()
+        {
+            int old = __atomic_exchange_n( &middle, back | FRESH, __ATOMIC_ACQ_REL );
+            back = old & INDEX;
+        }
+
+        // the latest published copy.  It stays put until the next read().
+        const T& read()
+        {
+            if ( __atomic_load_n( &middle, __ATOMIC_ACQUIRE ) & FRESH ) {
+                int old = __atomic_exchange_n( &middle, front, __ATOMIC_ACQ_REL );
+                front = old & INDEX;
+            }
+            return buffers[front];
+        }
+
+    private:
+        // middle holds the index of the middle copy, plus FRESH if the
+        // reader hasn't taken it yet.
+        enum { INDEX = 3, FRESH = 4 };
+
+        T buffers[3];
+        int back;     // writer's
+        int middle;   // shared
+        int front;    // reader's
+
+        // prevent copying or assignment
+        TripleBuffer& operator=(TripleBuffer&);
+        TripleBuffer(TripleBuffer&);
+    }; // end class TripleBuffer
+
+} // end namespace PatternSpace
+#endif  // PATTERN_SPACE_TRIPLEBUFFER_INCLUSION_GUARD
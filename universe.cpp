@@ -1,129 +1,911 @@
-/*
-  Implementation for Universe
-"In theory, the Universe is implemented in LISP, but in practice it's mostly
-hacked together with Perl scripts."
-
-  The direct checks on the Solid::descriptor() are ugly and will scale poorly.
-That needs to be factored out, perhaps by having a table that defines the
-allowed interactions between different types of Solids.  
-
-  One service that Universe could provide (but doesn't currently) is only
-running interactions between objects that are fairly close to the Ship.  If
-"active" area was small compared to the entire universe, this could result
-in considerable savings.
-
-*/
-#include "universe.h"
-#include "factories.h"
-
-namespace PatternSpace {
-
-/*********************  Universe  *********************/
-    Universe::Universe(Screen* iscreen, Background* ibackground):
-        screen(*iscreen), background(*ibackground)
-    {}
-    
-    Universe::~Universe() {}
-    
-    Vector2d Universe::center()
-    {
-        return screen.origin() + (screen.size() / 2);
-    }
-    
-    Universe& Universe::center(Vector2d newCenter) 
-    {
-        screen.origin( newCenter - (screen.size() / 2) );
-        return *this;
-    }
-    
-    Universe& Universe::add( boost::shared_ptr<Solid> pSolid) 
-    {
-        addList.push_back(pSolid);
-        return *this;
-    }
-    Universe& Universe::simulateAll(double deltaTime) 
-    {
-        interactAll();  // n^2 interactions between solids
-        normalizeAll(); // clean up the allSolids list
-        stepAll(deltaTime);    // advance each solid
-    }
-    
-    // n^2 interactions between solids
-    Universe& Universe::interactAll() 
-    {
-        std::list<boost::shared_ptr<Solid> >::iterator ppSolid1;
-        std::list<boost::shared_ptr<Solid> >::iterator ppSolid2;
-        for( ppSolid1 = allSolids.begin(); ppSolid1 != allSolids.end(); ppSolid1++) {
-            if ( (**ppSolid1).descriptor() != 2) {
-                Lock lock1( **ppSolid1 );
-                ppSolid2 = ppSolid1;
-                ppSolid2++;
-                for( ; ppSolid2 != allSolids.end(); ppSolid2++ ) {
-                    if ( (**ppSolid2).descriptor() != 2) {
-                        Lock lock2( **ppSolid2 );
-                        gravitate( **ppSolid1, **ppSolid2);  // TODO: allow the client to register arbitrary interaction functions
-                        collision( **ppSolid1, **ppSolid2);
-                    }
-                }
-            }
-        }
-        return *this;
-    }
-    
-    // predicate used by normalizeAll
-    bool isDead(boost::shared_ptr<Solid> pSolid) { return pSolid->isDead(); }
-    
-    // add newly spawned Solids to the universe, and clean up the dead ones.
-    Universe& Universe::normalizeAll() 
-    {
-        Lock lock(allResource);
-
-        // add explosions where objects died.
-        std::list<boost::shared_ptr<Solid> >::iterator ppSolid;    
-        for( ppSolid = allSolids.begin(); ppSolid != allSolids.end(); ppSolid++) {
-            if ( isDead( *ppSolid) && ((**ppSolid).descriptor() != 2) ) {
-                boost::shared_ptr<Solid> pExplosion = newExplosion( (**ppSolid).position(), (**ppSolid).velocity() );
-                add( pExplosion );
-            }
-        }
-        
-        // ask each Solids if it would like to spawn some new Solids.
-        for( ppSolid = allSolids.begin(); ppSolid != allSolids.end(); ppSolid++) {
-            while ( (**ppSolid).hasSpawn() ) {
-                add( (**ppSolid).nextSpawn() );
-            }
-        }
-        
-        allSolids.remove_if( isDead );
-        allSolids.splice( allSolids.end(), addList);
-    }
-    
-    // update the velocity and position of each solid according to
-    // applied forces.
-    Universe& Universe::stepAll(double deltaTime) 
-    {
-        std::list<boost::shared_ptr<Solid> >::iterator ppSolid;
-        for( ppSolid = allSolids.begin(); ppSolid != allSolids.end(); ppSolid++) {
-            Lock lock( **ppSolid );
-            (*ppSolid)->step(deltaTime);
-        }            
-        return *this;
-    }
-    
-    // draw each solid.
-    Universe& Universe::drawAll() 
-    {
-        Lock allLock(allResource);
-        screen.clear();
-        background.draw(screen);
-        std::list<boost::shared_ptr<Solid> >::iterator ppSolid;
-        for( ppSolid = allSolids.begin(); ppSolid != allSolids.end(); ppSolid++) {
-            Lock lock( **ppSolid );
-            (*ppSolid)->draw(screen);
-        }
-   		screen.flip();
-
-        return *this;
-    }
-    
-} // end namespace PatternSpace
+/*
+  Implementation for Universe
+"In theory, the Universe is implemented in LISP, but in practice it's mostly
+hacked together with Perl scripts."
+
+  The interactions between different types of Solids come from a table,
+filled in by interaction().  Whenever it changes, the groups of descriptors
+that gravitate() and collide() among themselves are worked out again, and
+kept in kinds.
+
+  Level of detail is decided at the start of each step, in detailAll().  A
+dormant Solid simply isn't bucketed, so none of the interaction code ever
+sees it; stepAll() keeps track of the time it's owed.  The dormant are
+staggered across the stride, so about the same number are stepped each step.
+Their Masses are integrated one at a time, after the MassPool's pass, since
+each has its own deltaTime.
+
+  The original loop applies each registered interaction to each pair in
+turn, bucket by bucket, and it's kept as the reference whenever both modes
+are left at their defaults.  Otherwise, gravity is applied to all the
+gravitating group first, then collisions within the colliding group, and
+then anything else in the table, through the same bucket loops as the
+original.  With UNIFORM_GRID, collisions are only tested between the
+candidate pairs reported by the grid.  The grid is sized from the largest
+radius in the Universe, so it never misses a contact that was already there
+at the start of the step.
+
+  Outside the original loop, the interacting Solids are also packed into
+plain arrays, and the pairwise gravity and the grid's candidates go through
+the batch kernels (see kernels.h) instead of gravitate() and collision().
+
+  With more than one thread, the work is shared out through a TaskPool.
+Pairwise gravity is cut into tiles of TILE_SIZE by TILE_SIZE pairs, each of
+which adds up its forces in its own part of tileFx and tileFy; the tiles are
+then added up in order.  The Barnes-Hut forces and the grid's contacts are
+worked out in blocks, each of which writes only its own entries.  Only the
+Solids themselves are changed afterwards, serially, rather than taking a Lock
+on every Solid along the way.  Since none of this
+depends on which thread ran which task, two threads give exactly the same
+answer as sixteen.  One thread runs the serial code, unchanged.  Brute force
+collisions are always serial, because each one can move the Solids the next
+one looks at.
+
+*/
+#include <algorithm>
+
+#include "universe.h"
+#include "factories.h"
+#include "clock.h"
+
+namespace PatternSpace {
+
+/*********************  Interaction Jobs  *********************/
+    // the pairs within one block of bodies, or between two blocks.
+    class GravityTileJob : public TaskPool::Job {
+    public:
+        explicit GravityTileJob(Universe& u): universe(u) {}
+        void run(int task)
+        {
+            const Universe::Tile& tile = universe.tiles[task];
+            Universe::Packed& packed = universe.packed;
+            double* fx = &universe.tileFx[tile.offset];
+            double* fy = &universe.tileFy[tile.offset];
+            int i = tile.row;
+            if ( tile.columns == 0 ) {
+                pairwiseGravity( tile.rows, &packed.x[i], &packed.y[i], &packed.mass[i], &packed.radius[i],
+                                 fx, fy );
+                return;
+            }
+            int j = tile.column;
+            crossGravity( tile.rows, &packed.x[i], &packed.y[i], &packed.mass[i], &packed.radius[i],
+                          tile.columns, &packed.x[j], &packed.y[j], &packed.mass[j], &packed.radius[j],
+                          fx, fy, fx + tile.rows, fy + tile.rows );
+        }
+    private:
+        Universe& universe;
+    };
+
+    // the Barnes-Hut force on one block of bodies.
+    class TreeForceJob : public TaskPool::Job {
+    public:
+        explicit TreeForceJob(Universe& u): universe(u) {}
+        void run(int task)
+        {
+            Universe::Packed& packed = universe.packed;
+            int end = std::min<int>( (task + 1) * Universe::BODY_BLOCK, universe.tree.count() );
+            for( int i = task * Universe::BODY_BLOCK; i < end; i++ ) {
+                Vector2d F = universe.tree.force(i);
+                packed.fx[i] = F.x();
+                packed.fy[i] = F.y();
+                if ( universe.gravitation == Universe::BARNES_HUT_CHECKED ) {
+                    Vector2d exact = universe.tree.exactForce(i);
+                    packed.exactFx[i] = exact.x();
+                    packed.exactFy[i] = exact.y();
+                }
+            }
+        }
+    private:
+        Universe& universe;
+    };
+
+    // the contacts among one block of the grid's candidates.
+    class ContactJob : public TaskPool::Job {
+    public:
+        explicit ContactJob(Universe& u): universe(u) {}
+        void run(int task)
+        {
+            Universe::Packed& packed = universe.packed;
+            int start = task * Universe::CANDIDATE_BLOCK;
+            int count = std::min<int>( Universe::CANDIDATE_BLOCK, int(universe.candidates.size()) - start );
+            Contact* contacts = &universe.contacts[start];
+            int found = collisionContacts( count, &universe.candidates[start],
+                                           &packed.x[0], &packed.y[0], &packed.vx[0], &packed.vy[0],
+                                           &packed.mass[0], &packed.radius[0], universe.sweep, contacts );
+            for( int c = 0; c < found; c++ ) {
+                contacts[c].pair += start;
+            }
+            universe.found[task] = found;
+        }
+    private:
+        Universe& universe;
+    };
+
+    // for SlotMap::eraseIf(); by reference, so as not to touch the count.
+    static bool isDead(const boost::shared_ptr<Solid>& pSolid)
+    {
+        return pSolid->isDead();
+    }
+
+/*********************  PhaseTimer  *********************/
+    // adds the time until the end of its scope to a phase's total.
+    class PhaseTimer {
+    public:
+        explicit PhaseTimer(unsigned long long& total):
+            total(total), start( nanoseconds() ) {}
+        ~PhaseTimer() { total += nanoseconds() - start; }
+    private:
+        unsigned long long& total;
+        unsigned long long start;
+    };
+
+/*********************  Universe  *********************/
+    Universe::Universe(Screen* iscreen, Background* ibackground):
+        joined(0), serials(0), allResource( newResource() ), screen(*iscreen), background(*ibackground),
+        lastOrigin( iscreen->origin() ), nextOrigin( iscreen->origin() ),
+        published(0), drawing(0), painted(true), margin(64),
+        activeRange(0), dormantStride(4), steps(0),
+        collisions(BRUTE_FORCE), swept(false), sweep(0), gravitation(PAIRWISE),
+        workers( new TaskPool(1) ), gravitating(0), maxRadius(0), maxSpeed(0)
+    {
+        tierCounts.active = tierCounts.dormant = 0;
+        tierCounts.promoted = tierCounts.demoted = 0;
+        error.mean = error.worst = 0;
+        error.bodies = 0;
+        for( int phase = 0; phase < PHASES; phase++ ) phaseTimes[phase] = 0;
+        cullCounts.frames = cullCounts.drawn = cullCounts.culled = 0;
+        cullCounts.lastDrawn = cullCounts.lastCulled = 0;
+    }
+    
+    Universe::~Universe() {}
+    
+    Vector2d Universe::center()
+    {
+        return nextOrigin + (screen.size() / 2);
+    }
+    
+    Universe& Universe::center(Vector2d newCenter) 
+    {
+        lastOrigin = nextOrigin;
+        nextOrigin = newCenter - (screen.size() / 2);
+        return *this;
+    }
+    
+    Universe& Universe::follow(SolidHandle solid)
+    {
+        followed = solid;
+        return *this;
+    }
+
+    // every Solid gets a new serial number as it comes in, even one that's
+    // been restarted, or made where a dead one used to be, so the
+    // ContactSolver never takes it for a Solid it's seen before.
+    SolidHandle Universe::add( boost::shared_ptr<Solid> pSolid) 
+    {
+        pSolid->detail.serial = ++serials;
+        return allSolids.insert(pSolid);
+    }
+
+    Universe& Universe::add( const std::vector< boost::shared_ptr<Solid> >& solids,
+                             std::vector<SolidHandle>* handles )
+    {
+        std::vector< boost::shared_ptr<Solid> >::const_iterator ppSolid;
+        for( ppSolid = solids.begin(); ppSolid != solids.end(); ppSolid++ ) {
+            (*ppSolid)->detail.serial = ++serials;
+        }
+        allSolids.insert( solids.begin(), solids.end(), handles );
+        return *this;
+    }
+
+    Solid* Universe::find(SolidHandle solid)
+    {
+        boost::shared_ptr<Solid>* ppSolid = allSolids.find(solid);
+        return ppSolid ? ppSolid->get() : 0;
+    }
+
+    Universe& Universe::interaction(int descriptor1, int descriptor2, Interaction fn)
+    {
+        if ( descriptor1 < 0 || descriptor2 < 0 ) return *this;
+        Entry entry;
+        entry.low = std::min( descriptor1, descriptor2 );
+        entry.high = std::max( descriptor1, descriptor2 );
+        entry.fn = fn;
+        entry.swapped = descriptor1 > descriptor2;
+        interactions.push_back(entry);
+
+        if ( int(kinds.size()) <= entry.high ) kinds.resize( entry.high + 1 );
+        kinds[entry.low].interacts = kinds[entry.high].interacts = true;
+
+        // a descriptor is in a group if it has fn with itself, and with
+        // every other descriptor that has fn with itself.
+        int count = int(kinds.size());
+        std::vector<char> selfGravity(count), selfCollision(count);
+        for( int d = 0; d < count; d++ ) {
+            selfGravity[d] = registered( d, d, gravitate );
+            selfCollision[d] = registered( d, d, collision );
+        }
+        for( int d = 0; d < count; d++ ) {
+            kinds[d].gravitates = selfGravity[d];
+            kinds[d].collides = selfCollision[d];
+            for( int e = 0; e < count; e++ ) {
+                int low = std::min( d, e ), high = std::max( d, e );
+                if ( selfGravity[e] && !registered( low, high, gravitate ) ) kinds[d].gravitates = false;
+                if ( selfCollision[e] && !registered( low, high, collision ) ) kinds[d].collides = false;
+            }
+        }
+        return *this;
+    }
+
+    bool Universe::registered(int low, int high, Interaction fn) const
+    {
+        std::vector<Entry>::const_iterator pEntry;
+        for( pEntry = interactions.begin(); pEntry != interactions.end(); pEntry++ ) {
+            if ( pEntry->low == low && pEntry->high == high && pEntry->fn == fn ) return true;
+        }
+        return false;
+    }
+
+    // whether the bulk engines take care of this entry.
+    bool Universe::inBulk(int low, int high, Interaction fn) const
+    {
+        if ( fn == gravitate ) return kinds[low].gravitates && kinds[high].gravitates;
+        if ( fn == collision ) return kinds[low].collides && kinds[high].collides;
+        return false;
+    }
+
+    Universe& Universe::collisionMode(CollisionMode mode)
+    {
+        collisions = mode;
+        return *this;
+    }
+
+    Universe::CollisionMode Universe::collisionMode() const
+    {
+        return collisions;
+    }
+
+    Universe& Universe::sweptCollisions(bool state)
+    {
+        swept = state;
+        return *this;
+    }
+
+    bool Universe::sweptCollisions() const
+    {
+        return swept;
+    }
+
+    Universe& Universe::contactIterations(int count)
+    {
+        solver.iterations(count);
+        return *this;
+    }
+
+    int Universe::contactIterations() const
+    {
+        return solver.iterations();
+    }
+
+    const ContactSolver::Stats& Universe::contactStats() const
+    {
+        return solver.stats();
+    }
+
+    Universe& Universe::gravityMode(GravityMode mode)
+    {
+        gravitation = mode;
+        return *this;
+    }
+
+    Universe::GravityMode Universe::gravityMode() const
+    {
+        return gravitation;
+    }
+
+    Universe& Universe::openingAngle(double theta)
+    {
+        tree.openingAngle(theta);
+        return *this;
+    }
+
+    double Universe::openingAngle() const
+    {
+        return tree.openingAngle();
+    }
+
+    const Universe::GravityError& Universe::gravityError() const
+    {
+        return error;
+    }
+
+    Universe& Universe::threads(int count)
+    {
+        if ( count < 1 ) count = 1;
+        if ( count != workers->threads() ) workers.reset( new TaskPool(count) );
+        return *this;
+    }
+
+    int Universe::threads() const
+    {
+        return workers->threads();
+    }
+
+    Universe& Universe::activeRegion(double radius, int stride)
+    {
+        activeRange = radius > 0 ? radius : 0;
+        dormantStride = stride > 1 ? stride : 1;
+        return *this;
+    }
+
+    double Universe::activeRadius() const
+    {
+        return activeRange;
+    }
+
+    const Universe::Tiers& Universe::tiers() const
+    {
+        return tierCounts;
+    }
+
+    Universe& Universe::cullMargin(double pixels)
+    {
+        margin = pixels;
+        return *this;
+    }
+
+    double Universe::cullMargin() const
+    {
+        return margin;
+    }
+
+    const Universe::Culling& Universe::culling() const
+    {
+        return cullCounts;
+    }
+
+    Universe& Universe::simulateAll(double deltaTime) 
+    {
+        steps++;
+        {
+            LockPhase phase( phaseLocks[INTERACT] );
+            PhaseTimer timer( phaseTimes[INTERACT] );
+            sweep = swept ? deltaTime / REFERENCE_STEP : 0;
+            detailAll();    // who's active this step
+            interactAll(deltaTime);  // n^2 interactions between solids
+        }
+        {
+            LockPhase phase( phaseLocks[NORMALIZE] );
+            PhaseTimer timer( phaseTimes[NORMALIZE] );
+            normalizeAll(); // clean up the allSolids list
+        }
+        {
+            LockPhase phase( phaseLocks[STEP] );
+            PhaseTimer timer( phaseTimes[STEP] );
+            stepAll(deltaTime);    // advance each solid
+        }
+        {
+            LockPhase phase( phaseLocks[PUBLISH] );
+            PhaseTimer timer( phaseTimes[PUBLISH] );
+            publish(deltaTime);    // for drawAll()
+        }
+        return *this;
+    }
+
+    // FNV-1a over the bits of each Solid's state, in order.
+    unsigned long long Universe::digest() const
+    {
+        unsigned long long hash = 14695981039346656037ULL;
+        for( size_t i = 0; i < joined; i++ ) {
+            const Solid& solid = *allSolids[i];
+            double state[5] = { solid.position().x(), solid.position().y(),
+                                solid.velocity().x(), solid.velocity().y(), solid.angle() };
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(state);
+            for( size_t i = 0; i < sizeof(state); i++ ) {
+                hash ^= bytes[i];
+                hash *= 1099511628211ULL;
+            }
+        }
+        return hash;
+    }
+
+    const LockStats& Universe::lockStats(Phase phase) const
+    {
+        return phaseLocks[phase];
+    }
+
+    unsigned long long Universe::phaseTime(Phase phase) const
+    {
+        return phaseTimes[phase];
+    }
+
+    Universe& Universe::reportLocks(FILE* out)
+    {
+        static const char* names[PHASES] = { "interact", "normalize", "step", "publish", "draw" };
+        fprintf( out, "%-10s %12s %12s %14s\n", "phase", "acquires", "contended", "wait ms" );
+        for( int phase = 0; phase < PHASES; phase++ ) {
+            const LockStats& stats = phaseLocks[phase];
+            fprintf( out, "%-10s %12lu %12lu %14.3f\n", names[phase],
+                     stats.acquires, stats.contended, stats.waitNanoseconds / 1e6 );
+        }
+        return *this;
+    }
+    
+    // n^2 interactions between solids
+    Universe& Universe::interactAll(double deltaTime)
+    {
+        bucketAll();
+        if ( collisions != BRUTE_FORCE || gravitation != PAIRWISE || workers->threads() > 1 || solver.iterations() ) {
+            gatherInteracting();
+            gravitateAll();
+            collideAll(deltaTime);
+            interactBuckets(true);
+            return *this;
+        }
+        interactBuckets(false);
+        return *this;
+    }
+
+    // sort the Solids into active and dormant.  Solids that wake up are
+    // caught up on the time they missed before they interact again.
+    Universe& Universe::detailAll()
+    {
+        // leave this much room before putting a Solid back to sleep.
+        static const double HYSTERESIS = 1.25;
+
+        Solid* pFollowed = find(followed);
+        Vector2d focus = pFollowed ? pFollowed->position() : center();
+        double wake = activeRange * activeRange;
+        double sleep = wake * HYSTERESIS * HYSTERESIS;
+        tierCounts.active = tierCounts.dormant = 0;
+        tierCounts.promoted = tierCounts.demoted = 0;
+
+        for( size_t i = 0; i < joined; i++ ) {
+            Solid& solid = *allSolids[i];
+            Solid::Detail& detail = solid.detail;
+            Vector2d offset = solid.position() - focus;
+            double distance = dot( offset, offset );
+            if ( detail.dormant && ( activeRange == 0 || distance <= wake ) ) {
+                if ( detail.owed > 0 ) {
+                    Lock lock( solid );
+                    solid.step( detail.owed );
+                }
+                detail.dormant = false;
+                detail.owed = 0;
+                tierCounts.promoted++;
+            } else if ( !detail.dormant && activeRange > 0 && distance > sleep ) {
+                detail.dormant = true;
+                detail.stagger = int( tierCounts.demoted++ % dormantStride );
+            }
+            if ( detail.dormant ) tierCounts.dormant++;
+            else tierCounts.active++;
+        }
+        return *this;
+    }
+
+    // sort the Solids that take part in interactions by descriptor.
+    Universe& Universe::bucketAll()
+    {
+        buckets.resize( kinds.size() );
+        std::vector< std::vector<Solid*> >::iterator pBucket;
+        for( pBucket = buckets.begin(); pBucket != buckets.end(); pBucket++ ) {
+            pBucket->clear();
+        }
+        for( size_t i = 0; i < joined; i++ ) {
+            Solid* pSolid = allSolids[i].get();
+            int descriptor = pSolid->descriptor();
+            if ( !pSolid->detail.dormant && descriptor >= 0 && descriptor < int(kinds.size()) && kinds[descriptor].interacts ) {
+                buckets[descriptor].push_back( pSolid );
+            }
+        }
+        return *this;
+    }
+
+    // apply the table to every pair of buckets that has something in it,
+    // leaving out what the bulk engines have done already.
+    Universe& Universe::interactBuckets(bool bulk)
+    {
+        std::vector<Entry> entries;
+        int count = int(buckets.size());
+        for( int low = 0; low < count; low++ ) {
+            for( int high = low; high < count; high++ ) {
+                entries.clear();
+                std::vector<Entry>::iterator pEntry;
+                for( pEntry = interactions.begin(); pEntry != interactions.end(); pEntry++ ) {
+                    if ( pEntry->low == low && pEntry->high == high && !( bulk && inBulk( low, high, pEntry->fn ) ) ) {
+                        entries.push_back( *pEntry );
+                    }
+                }
+                if ( entries.empty() ) continue;
+
+                std::vector<Solid*>& lows = buckets[low];
+                std::vector<Solid*>& highs = buckets[high];
+                for( size_t i = 0; i < lows.size(); i++ ) {
+                    Lock lock1( *lows[i] );
+                    for( size_t j = ( low == high ) ? i + 1 : 0; j < highs.size(); j++ ) {
+                        Lock lock2( *highs[j] );
+                        for( pEntry = entries.begin(); pEntry != entries.end(); pEntry++ ) {
+                            Solid& solid1 = pEntry->swapped ? *highs[j] : *lows[i];
+                            Solid& solid2 = pEntry->swapped ? *lows[i] : *highs[j];
+                            if ( pEntry->fn == collision ) sweptCollision( solid1, solid2, sweep );
+                            else pEntry->fn( solid1, solid2 );
+                        }
+                    }
+                }
+            }
+        }
+        return *this;
+    }
+
+    // collect the bucketed Solids, the gravitating group first.  Only this
+    // thread changes a Solid, so reading them doesn't need a Lock.
+    Universe& Universe::gatherInteracting()
+    {
+        interacting.clear();
+        int count = int(buckets.size());
+        for( int d = 0; d < count; d++ ) {
+            if ( kinds[d].gravitates ) interacting.insert( interacting.end(), buckets[d].begin(), buckets[d].end() );
+        }
+        gravitating = interacting.size();
+        for( int d = 0; d < count; d++ ) {
+            if ( !kinds[d].gravitates ) interacting.insert( interacting.end(), buckets[d].begin(), buckets[d].end() );
+        }
+
+        size_t n = interacting.size();
+        colliding.resize(n);
+        packed.x.resize(n);
+        packed.y.resize(n);
+        packed.vx.resize(n);
+        packed.vy.resize(n);
+        packed.mass.resize(n);
+        packed.radius.resize(n);
+        maxRadius = maxSpeed = 0;
+        for( size_t i = 0; i < n; i++ ) {
+            Solid& solid = *interacting[i];
+            Vector2d position = solid.position();
+            Vector2d velocity = solid.velocity();
+            packed.x[i] = position.x();
+            packed.y[i] = position.y();
+            packed.vx[i] = velocity.x();
+            packed.vy[i] = velocity.y();
+            packed.mass[i] = solid.mass();
+            packed.radius[i] = solid.radius();
+            colliding[i] = kinds[ solid.descriptor() ].collides;
+            if ( colliding[i] && packed.radius[i] > maxRadius ) maxRadius = packed.radius[i];
+            if ( colliding[i] && velocity.magnitude() > maxSpeed ) maxSpeed = velocity.magnitude();
+        }
+        return *this;
+    }
+
+    Universe& Universe::gravitateAll()
+    {
+        size_t n = gravitating;
+        packed.fx.assign( n, 0.0 );
+        packed.fy.assign( n, 0.0 );
+        if ( gravitation == PAIRWISE ) {
+            if ( workers->threads() == 1 ) {
+                if ( n ) {
+                    pairwiseGravity( int(n), &packed.x[0], &packed.y[0], &packed.mass[0], &packed.radius[0],
+                                     &packed.fx[0], &packed.fy[0] );
+                }
+            } else {
+                tileGravity();
+            }
+        } else {
+            treeGravity();
+        }
+
+        for( size_t i = 0; i < n; i++ ) {
+            interacting[i]->push( Vector2d( packed.fx[i], packed.fy[i] ) );
+        }
+        return *this;
+    }
+
+    // pairwise gravity in tiles, so that it can be shared out to the
+    // workers.  Each tile adds up its forces in its own space, and then the
+    // tiles are added up in order.
+    Universe& Universe::tileGravity()
+    {
+        int n = int(gravitating);
+        int blocks = ( n + TILE_SIZE - 1 ) / TILE_SIZE;
+        tiles.clear();
+        int offset = 0;
+        for( int row = 0; row < blocks; row++ ) {
+            for( int column = row; column < blocks; column++ ) {
+                Tile tile;
+                tile.row = row * TILE_SIZE;
+                tile.rows = std::min<int>( TILE_SIZE, n - tile.row );
+                tile.column = column * TILE_SIZE;
+                tile.columns = ( row == column ) ? 0 : std::min<int>( TILE_SIZE, n - tile.column );
+                tile.offset = offset;
+                offset += tile.rows + tile.columns;
+                tiles.push_back(tile);
+            }
+        }
+        tileFx.assign( offset, 0.0 );
+        tileFy.assign( offset, 0.0 );
+
+        GravityTileJob job(*this);
+        workers->run( job, int(tiles.size()) );
+
+        std::vector<Tile>::iterator pTile;
+        for( pTile = tiles.begin(); pTile != tiles.end(); pTile++ ) {
+            for( int k = 0; k < pTile->rows; k++ ) {
+                packed.fx[pTile->row + k] += tileFx[pTile->offset + k];
+                packed.fy[pTile->row + k] += tileFy[pTile->offset + k];
+            }
+            for( int k = 0; k < pTile->columns; k++ ) {
+                packed.fx[pTile->column + k] += tileFx[pTile->offset + pTile->rows + k];
+                packed.fy[pTile->column + k] += tileFy[pTile->offset + pTile->rows + k];
+            }
+        }
+        return *this;
+    }
+
+    // Barnes-Hut gravity.  The tree is only read once it's built, so every
+    // body's force can be looked up on any worker.
+    Universe& Universe::treeGravity()
+    {
+        size_t n = gravitating;
+        tree.clear();
+        for( size_t i = 0; i < n; i++ ) {
+            tree.insert( Vector2d( packed.x[i], packed.y[i] ), packed.mass[i], packed.radius[i] );
+        }
+        tree.build();
+
+        if ( gravitation == BARNES_HUT_CHECKED ) {
+            packed.exactFx.resize(n);
+            packed.exactFy.resize(n);
+        }
+        TreeForceJob job(*this);
+        workers->run( job, int( (n + BODY_BLOCK - 1) / BODY_BLOCK ) );
+
+        double errorSum = 0;
+        error.mean = error.worst = 0;
+        error.bodies = 0;
+        if ( gravitation == BARNES_HUT_CHECKED ) {
+            for( size_t i = 0; i < n; i++ ) {
+                Vector2d F( packed.fx[i], packed.fy[i] );
+                Vector2d exact( packed.exactFx[i], packed.exactFy[i] );
+                double magnitude = exact.magnitude();
+                if ( magnitude > 0 ) {
+                    double relative = (F - exact).magnitude() / magnitude;
+                    errorSum += relative;
+                    if ( relative > error.worst ) error.worst = relative;
+                    error.bodies++;
+                }
+            }
+        }
+        if ( error.bodies ) error.mean = errorSum / error.bodies;
+        return *this;
+    }
+
+    Universe& Universe::collideAll(double deltaTime)
+    {
+        size_t n = interacting.size();
+        if ( n == 0 ) return *this;
+        bool solving = solver.iterations() > 0;
+        if ( solving ) {
+            // the solver has to see the pull of gravity to hold against it.
+            packed.nextVx.assign( packed.vx.begin(), packed.vx.end() );
+            packed.nextVy.assign( packed.vy.begin(), packed.vy.end() );
+            for( size_t i = 0; i < gravitating; i++ ) {
+                packed.nextVx[i] += packed.fx[i] * deltaTime / packed.mass[i];
+                packed.nextVy[i] += packed.fy[i] * deltaTime / packed.mass[i];
+            }
+            packed.serial.resize(n);
+            for( size_t i = 0; i < n; i++ ) packed.serial[i] = interacting[i]->detail.serial;
+            solver.begin( int(n), &packed.x[0], &packed.y[0], &packed.nextVx[0], &packed.nextVy[0], &packed.radius[0],
+                          &packed.serial[0], sweep );
+        }
+        if ( collisions == BRUTE_FORCE ) {
+            for( size_t i = 0; i < n; i++ ) {
+                if ( !colliding[i] ) continue;
+                for( size_t j = i + 1; j < n; j++ ) {
+                    if ( !colliding[j] ) continue;
+                    if ( solving ) solver.contact( int(i), *interacting[i], int(j), *interacting[j] );
+                    else sweptCollision( *interacting[i], *interacting[j], sweep );
+                }
+            }
+            if ( solving ) solver.solve(deltaTime);
+            return *this;
+        }
+
+        // any two touching circles are within two radii of each other, and
+        // two that will touch this step are within that plus the distance
+        // they can close in it.
+        grid.clear( 2 * maxRadius + 2 * maxSpeed * sweep );
+        for( size_t i = 0; i < n; i++ ) {
+            if ( colliding[i] ) grid.insert( int(i), Vector2d( packed.x[i], packed.y[i] ) );
+        }
+        candidates.clear();
+        grid.pairs(candidates);
+        if ( solving ) {
+            std::vector<UniformGrid::Pair>::iterator pPair;
+            for( pPair = candidates.begin(); pPair != candidates.end(); pPair++ ) {
+                solver.contact( pPair->first, *interacting[pPair->first], pPair->second, *interacting[pPair->second] );
+            }
+            solver.solve(deltaTime);
+            return *this;
+        }
+        if ( candidates.empty() ) return *this;
+
+        // the contacts are found on the workers, but have to be resolved
+        // one at a time, in order, because each one moves the Solids.
+        int blocks = int( (candidates.size() + CANDIDATE_BLOCK - 1) / CANDIDATE_BLOCK );
+        contacts.resize( candidates.size() );
+        found.resize( blocks );
+        ContactJob job(*this);
+        workers->run( job, blocks );
+
+        for( int block = 0; block < blocks; block++ ) {
+            for( int c = 0; c < found[block]; c++ ) {
+                const Contact& contact = contacts[ block * CANDIDATE_BLOCK + c ];
+                Solid& solid1 = *interacting[ candidates[contact.pair].first ];
+                Solid& solid2 = *interacting[ candidates[contact.pair].second ];
+                bounce( solid1, solid2, Vector2d( contact.axisX, contact.axisY ), contact.overlap, contact.impulse,
+                        contact.impact );
+            }
+        }
+        return *this;
+    }
+    
+    // add newly spawned Solids to the universe, and clean up the dead ones.
+    Universe& Universe::normalizeAll() 
+    {
+        Lock lock(*allResource);
+
+        // add explosions where objects died.  add() only appends, so the
+        // indices of the joined Solids don't change.
+        for( size_t i = 0; i < joined; i++ ) {
+            Solid& solid = *allSolids[i];
+            if ( solid.isDead() && ( solid.descriptor() != EFFECT ) ) {
+                add( newExplosion( solid.position(), solid.velocity() ) );
+            }
+        }
+        
+        // ask each Solids if it would like to spawn some new Solids.
+        for( size_t i = 0; i < joined; i++ ) {
+            Solid& solid = *allSolids[i];
+            while ( solid.hasSpawn() ) {
+                add( solid.nextSpawn() );
+            }
+        }
+        
+        // the painter may still be drawing the dead, so bury them rather
+        // than letting them go; see publish().
+        for( size_t i = 0; i < joined; i++ ) {
+            if ( allSolids[i]->isDead() ) {
+                graveyard.push_back( std::make_pair( published, allSolids[i] ) );
+            }
+        }
+        allSolids.eraseIf( isDead );
+        joined = allSolids.size();
+        return *this;
+    }
+    
+    // update the velocity and position of each solid according to
+    // applied forces.  Each Solid gets its step() as usual, but the Masses
+    // only get scheduled; the MassPool then integrates them all in one pass.
+    // Dormant Solids due this step go afterwards, each with its own time.
+    Universe& Universe::stepAll(double deltaTime) 
+    {
+        MassPool& masses = MassPool::instance();
+        masses.defer(true);
+        for( size_t i = 0; i < joined; i++ ) {
+            Solid& solid = *allSolids[i];
+            Solid::Detail& detail = solid.detail;
+            detail.stepped = !detail.dormant;
+            if ( detail.dormant ) {
+                detail.owed += deltaTime;
+                continue;
+            }
+            Lock lock( solid );
+            solid.step(deltaTime);
+        }            
+        masses.defer(false);
+        masses.stepAll(deltaTime);
+
+        if ( tierCounts.dormant == 0 ) return *this;
+        for( size_t i = 0; i < joined; i++ ) {
+            Solid& solid = *allSolids[i];
+            Solid::Detail& detail = solid.detail;
+            if ( detail.dormant && ( steps + detail.stagger ) % dormantStride == 0 ) {
+                Lock lock( solid );
+                solid.step( detail.owed );
+                detail.owed = 0;
+                detail.stepped = true;
+            }
+        }
+        return *this;
+    }
+
+    // hand the painter a copy of everything it needs for this step, then
+    // let go of the dead it can no longer be drawing.
+    Universe& Universe::publish(double deltaTime)
+    {
+        Solid* pFollowed = find(followed);
+        if ( pFollowed ) center( pFollowed->position() );
+
+        Snapshot& snapshot = snapshots.write();
+        snapshot.sprites.resize( joined );
+        std::vector<SpriteState>::iterator pState = snapshot.sprites.begin();
+        for( size_t i = 0; i < joined; i++, pState++) {
+            Solid& solid = *allSolids[i];
+            solid.snapshot(*pState);
+            // a dormant Solid that sat this step out is standing still.
+            if ( !solid.detail.stepped ) {
+                pState->lastPosition = pState->position;
+                pState->lastAngle = pState->angle;
+            }
+        }
+        snapshot.lastOrigin = lastOrigin;
+        snapshot.nextOrigin = nextOrigin;
+        snapshot.lastStep = SDL_GetTicks();
+        snapshot.stepLength = deltaTime;
+        snapshot.sequence = ++published;
+        snapshots.publish();
+
+        // a Solid buried at sequence s is in no Snapshot after s.
+        unsigned long reading = painted ? __atomic_load_n( &drawing, __ATOMIC_ACQUIRE ) : published + 1;
+        while ( !graveyard.empty() && graveyard.front().first < reading ) {
+            graveyard.pop_front();
+        }
+        return *this;
+    }
+    
+    Universe& Universe::painter(bool present)
+    {
+        painted = present;
+        return *this;
+    }
+
+    // draw each solid, as of the latest Snapshot.
+    Universe& Universe::drawAll() 
+    {
+        LockPhase phase( phaseLocks[DRAW] );
+        PhaseTimer timer( phaseTimes[DRAW] );
+        const Snapshot& snapshot = snapshots.read();
+        __atomic_store_n( &drawing, snapshot.sequence, __ATOMIC_RELEASE );
+
+        // how far we are from the last step to the next one.
+        double t = 1;
+        if ( snapshot.stepLength > 0 ) {
+            t = ( SDL_GetTicks() - snapshot.lastStep ) / snapshot.stepLength;
+            if ( t > 1 ) t = 1;
+        }
+        screen.blend(t);
+        screen.origin( snapshot.lastOrigin + ( snapshot.nextOrigin - snapshot.lastOrigin ) * t );
+
+        // the screen, in the Universe's coordinates.
+        Vector2d low = screen.origin();
+        Vector2d high = low + screen.size();
+
+        screen.clear();
+        background.draw(screen);
+        int drawn = 0, culled = 0;
+        std::vector<SpriteState>::const_iterator pState;
+        for( pState = snapshot.sprites.begin(); pState != snapshot.sprites.end(); pState++) {
+            if ( margin >= 0 ) {
+                Vector2d at = pState->at(t);
+                double reach = pState->radius + margin;
+                if ( at.x() + reach < low.x() || at.x() - reach > high.x() ||
+                     at.y() + reach < low.y() || at.y() - reach > high.y() ) {
+                    culled++;
+                    continue;
+                }
+            }
+            pState->draw(screen);
+            drawn++;
+        }
+   		screen.flip();
+
+        cullCounts.frames++;
+        cullCounts.drawn += drawn;
+        cullCounts.culled += culled;
+        cullCounts.lastDrawn = drawn;
+        cullCounts.lastCulled = culled;
+
+        return *this;
+    }
+    
+} // end namespace PatternSpace
@@ -1,63 +1,346 @@
-/*
-  Universe class
-  
-  A Universe is basically a collection of Solids.  Every Solid that's actively
-participating in the program will belong to the Universe, and the Universe is
-responsible for updating and displaying each object.  The Universe's primary
-responsibility is to provide thread safety when using a Solid.
-
-  The primary list of Solids is the allSolids vector.  However, we want to
-avoid changing the list while we are iterating over it, any new Solids that are
-spawned are not added directly to allSolids, but instead to the addList.  At
-the end of each step, we append the allList to the allSolids list.  Note that
-before we mutate the allSolids list, we must remember to obtain the allResource.
-
-*/
-#ifndef PATTERN_SPACE_UNIVERSE_INCLUSION_GUARD
-#define PATTERN_SPACE_UNIVERSE_INCLUSION_GUARD
-
-#include <list>
-#include <boost/shared_ptr.hpp>
-
-#include "vector2d.h"
-#include "solid.h"
-#include "image.h"
-
-namespace PatternSpace {
-    
-/*********************  Universe  *********************/
-    class Universe {
-    public:
-        Universe(Screen* screen,Background* background);
-        ~Universe();
-        // bind screen.orgin + (WIDTH/2, HEIGHT/2)
-        Universe& center(Vector2d center);
-        Vector2d center();
-        
-        Universe& add( boost::shared_ptr<Solid> );
-
-        // Physics simulation
-        Universe& simulateAll(double deltaTime);
-
-        // display
-        Universe& drawAll();
-    private:
-        // Physics simulation
-        Universe& stepAll(double deltaTime);     
-        Universe& normalizeAll();   
-        Universe& interactAll();
-        
-        std::list< boost::shared_ptr<Solid> > addList;
-        std::list< boost::shared_ptr<Solid> > allSolids;
-        Resource allResource;  // lockable resource for the all list
-        Screen& screen;
-        Background& background;
-        
-        // prevent copying or assignment
-        Universe& operator=(Universe&);
-        Universe(Universe&);
-
-    }; // end class Universe
-        
-} // end namespace PatternSpace
-#endif  // PATTERN_SPACE_UNIVERSE_INCLUSION_GUARD
+/*
+  Universe class
+  
+  A Universe is basically a collection of Solids.  Every Solid that's actively
+participating in the program will belong to the Universe, and the Universe is
+responsible for updating and displaying each object.  The Universe's primary
+responsibility is to provide thread safety when using a Solid.
+
+  The Solids are kept in allSolids, a SlotMap, so they can be gone through
+like an array, and anyone outside can keep a SolidHandle to one instead of a
+reference that would keep it alive.  find() turns the handle back into the
+Solid for as long as it's in the Universe.  New Solids go on the end of
+allSolids straight away, so their handles work at once, but they don't join
+in until the end of the step: only the first joined Solids are simulated.
+Note that before we mutate allSolids, we must remember to obtain the
+allResource.
+
+  Collisions can be found two ways.  BRUTE_FORCE tests every pair, which is
+the original behavior and is kept as a reference.  UNIFORM_GRID only tests
+pairs that a UniformGrid broadphase reports as neighbors, which is roughly
+linear in the number of Solids.  Both find the same contacts, except that a
+pair knocked together by an earlier collision in the same step is only found
+by the grid on the next step.
+
+  Either way, collisions are normally only looked for at the start of each
+step, so a Solid fast enough to cross another in one step can pass right
+through it, and the step rate has to be kept up to stop that.  With
+sweptCollisions() on, every pair is followed along its motion through the
+step as well (see sweptCollision() in mass.h), and the grid's cells are made
+big enough to hold the fastest Solid's travel.
+
+  Tightly packed Solids are better off with contactIterations(): the
+contacts found either way are then solved together by a ContactSolver
+(see contactsolver.h) rather than bounced one pair at a time, so clusters
+settle rather than jitter.  The solver runs in one thread.
+
+  Gravity can also be computed two ways.  PAIRWISE applies gravitate() to
+every pair, or runs the same sum through the batch kernels in kernels.h when
+the collision mode isn't the default.  BARNES_HUT uses a quadtree to
+approximate distant groups of Solids as single masses; see gravity.h.
+BARNES_HUT_CHECKED does the same, but also computes the exact pairwise forces
+and records how far off the approximation was in gravityError().  That's n^2
+again, so it's only for testing.
+
+  The physics and the drawing run in different threads at different rates,
+and they don't share the Solids.  At the end of every step, simulateAll()
+publishes a Snapshot: a SpriteState for every Solid, plus the camera and the
+time of the step.  drawAll() draws the latest Snapshot, without taking any
+locks, so neither thread ever waits for the other.  The Snapshots go through a
+TripleBuffer, so the painter never sees one half written.  The drawing is
+blended between the last two steps (see Screen::blend()), and so is the
+camera, which follow()s a Solid or is moved with center() once a step.
+Solids whose bounding circles are well off the screen aren't drawn at all;
+culling() counts them.
+
+  Which Solids interact with which is up to the client.  Each interaction
+is a function registered for a pair of descriptors (see Solid), and a Solid
+whose descriptor has nothing registered, such as an explosion, is never
+considered at all.  Every step the Solids are sorted into buckets by
+descriptor, and only the pairs of buckets that have something registered are
+looped over.  gravitate() and collision() are recognized, so that where they
+are registered for every pair among a group of descriptors, that group can go
+through the faster engines below as a whole.  A new Universe has no
+interactions; see standardInteractions() in factories.h for the game's.
+
+  Most of a large map is nowhere near the Ship.  With an activeRegion(),
+only the Solids within its radius of the focus (the followed Solid, or the
+center()) get the full treatment.  The rest are dormant: they take no part in
+any interaction, and they're only stepped once every stride steps, through
+all the time they've missed at once.  A dormant Solid is woken as soon as it
+comes back within the radius, and caught up first, so it rejoins the
+interactions where it would have been had it coasted all along.  It isn't
+put back to sleep until it's a little further out than that, so Solids near
+the edge don't flip back and forth.  tiers() counts the Solids on each side.
+
+  When Resource::recording() is on, the Universe keeps the lock statistics
+for each phase of a step separately (see LockPhase in lock.h), and
+reportLocks() prints them, so it's easy to see where the time waiting for
+locks is going.
+
+  A SpriteState points at its Solid's Image, so a dead Solid can't be
+destroyed while the painter might still be drawing a Snapshot it's in.
+Instead it's kept in the graveyard, and let go once the painter has moved on
+to a later Snapshot.  A Universe that's never drawn (say, in a benchmark)
+should say so with painter(false), or the graveyard will only grow.
+
+*/
+#ifndef PATTERN_SPACE_UNIVERSE_INCLUSION_GUARD
+#define PATTERN_SPACE_UNIVERSE_INCLUSION_GUARD
+
+#include <stdio.h>
+#include <list>
+#include <memory>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include "vector2d.h"
+#include "solid.h"
+#include "image.h"
+#include "broadphase.h"
+#include "gravity.h"
+#include "kernels.h"
+#include "taskpool.h"
+#include "triplebuffer.h"
+#include "slotmap.h"
+#include "contactsolver.h"
+
+namespace PatternSpace {
+
+    typedef SlotMap< boost::shared_ptr<Solid> >::Handle SolidHandle;
+
+    class GravityTileJob;
+    class TreeForceJob;
+    class ContactJob;
+    
+/*********************  Universe  *********************/
+    class Universe {
+    public:
+        enum CollisionMode { BRUTE_FORCE, UNIFORM_GRID };
+        enum GravityMode { PAIRWISE, BARNES_HUT, BARNES_HUT_CHECKED };
+        // the parts of simulateAll(), and drawAll().
+        enum Phase { INTERACT, NORMALIZE, STEP, PUBLISH, DRAW, PHASES };
+
+        // relative error of the Barnes-Hut forces during the last step,
+        // only measured in BARNES_HUT_CHECKED mode.
+        struct GravityError {
+            double mean;
+            double worst;
+            int bodies;
+        };
+
+        Universe(Screen* screen,Background* background);
+        ~Universe();
+        // bind screen.orgin + (WIDTH/2, HEIGHT/2), as of the last step.
+        Universe& center(Vector2d center);
+        Vector2d center();
+        // center on this Solid after every step.
+        Universe& follow(SolidHandle solid);
+        
+        // the Solid joins in at the end of the step.
+        SolidHandle add( boost::shared_ptr<Solid> );
+        // add a whole scene at once, putting the handles in handles.
+        Universe& add( const std::vector< boost::shared_ptr<Solid> >& solids,
+                       std::vector<SolidHandle>* handles = 0 );
+        // the Solid, or 0 if it's died and gone.
+        Solid* find(SolidHandle solid);
+
+        // something two Solids do to each other every step.
+        typedef void (*Interaction)( Mass&, Mass& );
+        // apply fn to every pair of Solids with these descriptors, passed in
+        // this order.  Interactions for the same pair run in the order they
+        // were registered.
+        Universe& interaction(int descriptor1, int descriptor2, Interaction fn);
+
+        // choose how collision candidates are found.
+        Universe& collisionMode(CollisionMode mode);
+        CollisionMode collisionMode() const;
+        // look for collisions along the whole of each step, rather than
+        // only at its start.  Off by default.
+        Universe& sweptCollisions(bool state);
+        bool sweptCollisions() const;
+        // solve the contacts with this many iterations of a ContactSolver.
+        // Zero, the default, bounces each pair with collision().
+        Universe& contactIterations(int count);
+        int contactIterations() const;
+        const ContactSolver::Stats& contactStats() const;
+
+        // choose how gravity is computed.
+        Universe& gravityMode(GravityMode mode);
+        GravityMode gravityMode() const;
+        // Barnes-Hut opening angle; smaller is slower and more accurate.
+        Universe& openingAngle(double theta);
+        double openingAngle() const;
+        const GravityError& gravityError() const;
+
+        // how many threads share the interaction work, counting the one
+        // that calls simulateAll().  The default of one runs it all serially.
+        Universe& threads(int count);
+        int threads() const;
+
+        // only simulate fully within radius of the focus, and step the
+        // rest every stride steps.  A radius of zero (the default) makes
+        // everything active.
+        Universe& activeRegion(double radius, int stride);
+        double activeRadius() const;
+
+        // how many Solids were in each tier as of the last step, and how
+        // many moved between them.
+        struct Tiers {
+            int active, dormant;
+            int promoted, demoted;
+        };
+        const Tiers& tiers() const;
+
+        // don't draw a Solid whose bounding circle is further than margin
+        // pixels off the screen (64 by default).  A negative margin draws
+        // everything.
+        Universe& cullMargin(double margin);
+        double cullMargin() const;
+        // how many Solids drawAll() drew and culled, over every frame and in
+        // the last one.  Counted on the painter's thread.
+        struct Culling {
+            unsigned long frames;
+            unsigned long drawn, culled;
+            int lastDrawn, lastCulled;
+        };
+        const Culling& culling() const;
+
+        // lock statistics for each phase, when Resource::recording() is on.
+        const LockStats& lockStats(Phase phase) const;
+        // total time spent in each phase, in nanoseconds.  DRAW is counted
+        // on the painter's thread, so only read it from there.
+        unsigned long long phaseTime(Phase phase) const;
+        Universe& reportLocks(FILE* out);
+
+        // Physics simulation
+        Universe& simulateAll(double deltaTime);
+        // a hash of where every Solid is and how it's moving.  Two runs
+        // that come out the same, down to the last bit, have the same digest.
+        unsigned long long digest() const;
+
+        // display; call from one thread only.
+        Universe& drawAll();
+        // whether anyone calls drawAll().  Without a painter, the dead are
+        // let go as soon as they die.  Change it before the first step.
+        Universe& painter(bool present);
+    private:
+        // Physics simulation
+        Universe& stepAll(double deltaTime);     
+        Universe& normalizeAll();   
+        Universe& publish(double deltaTime);
+        Universe& detailAll();
+        Universe& interactAll(double deltaTime);
+        Universe& bucketAll();
+        Universe& interactBuckets(bool bulk);
+        bool registered(int low, int high, Interaction fn) const;
+        bool inBulk(int low, int high, Interaction fn) const;
+        Universe& gatherInteracting();
+        Universe& gravitateAll();
+        Universe& tileGravity();
+        Universe& treeGravity();
+        Universe& collideAll(double deltaTime);
+
+        friend class GravityTileJob;
+        friend class TreeForceJob;
+        friend class ContactJob;
+        
+        SlotMap< boost::shared_ptr<Solid> > allSolids;
+        size_t joined;                        // allSolids that are simulated
+        unsigned long serials;                // handed out by add()
+        std::auto_ptr<Resource> allResource;  // lockable resource for the all list
+        LockStats phaseLocks[PHASES];
+        unsigned long long phaseTimes[PHASES];
+        Screen& screen;
+        Background& background;
+        SolidHandle followed;
+        Vector2d lastOrigin, nextOrigin;  // screen origin after the last two steps
+
+        // everything drawAll() needs, as of the end of a step.
+        struct Snapshot {
+            Snapshot(): lastStep(0), stepLength(0), sequence(0) {}
+            std::vector<SpriteState> sprites;
+            Vector2d lastOrigin, nextOrigin;
+            Uint32 lastStep;          // SDL_GetTicks() after the step
+            double stepLength;        // deltaTime of the step
+            unsigned long sequence;   // counts up from 1
+        };
+        TripleBuffer<Snapshot> snapshots;
+        unsigned long published;      // sequence of the latest Snapshot
+        unsigned long drawing;        // sequence the painter is drawing; atomic
+        bool painted;                 // there is a painter
+        double margin;                // for culling
+        Culling cullCounts;
+        // dead Solids, and the latest Snapshot they might be in.
+        std::list< std::pair<unsigned long, boost::shared_ptr<Solid> > > graveyard;
+
+        // the registered interactions, in order, with low <= high.
+        struct Entry {
+            int low, high;
+            Interaction fn;
+            bool swapped;   // pass the high descriptor's Solid first
+        };
+        std::vector<Entry> interactions;
+        // what each descriptor takes part in.  gravitates and collides mark
+        // the groups that have gravitate() or collision() registered
+        // between every pair of their members.
+        struct Kind {
+            Kind(): interacts(false), gravitates(false), collides(false) {}
+            bool interacts, gravitates, collides;
+        };
+        std::vector<Kind> kinds;
+        std::vector< std::vector<Solid*> > buckets;  // by descriptor
+
+        // level of detail
+        double activeRange;
+        int dormantStride;
+        unsigned long steps;      // counts simulateAll()s
+        Tiers tierCounts;
+
+        CollisionMode collisions;
+        bool swept;
+        double sweep;             // this step's, for sweptCollision()
+        ContactSolver solver;
+        GravityMode gravitation;
+        UniformGrid grid;
+        BarnesHut tree;
+        GravityError error;
+        std::auto_ptr<TaskPool> workers;
+        // scratch space for interactAll: the bucketed Solids, with the
+        // gravitating group first.
+        std::vector<Solid*> interacting;
+        size_t gravitating;               // how many are in that group
+        std::vector<char> colliding;      // which are in the colliding group
+        double maxRadius;                 // largest radius of those
+        double maxSpeed;                  // and largest speed
+        std::vector<UniformGrid::Pair> candidates;
+
+        // interacting, packed into arrays for the batch kernels
+        struct Packed {
+            std::vector<double> x, y, vx, vy, mass, radius;
+            std::vector<double> fx, fy;
+            std::vector<double> exactFx, exactFy;
+            std::vector<double> nextVx, nextVy;   // with gravity, for the solver
+            std::vector<unsigned long> serial;    // for the solver
+        } packed;
+        std::vector<Contact> contacts;
+
+        // work shared out to the TaskPool; see universe.cpp
+        enum { TILE_SIZE = 128, BODY_BLOCK = 64, CANDIDATE_BLOCK = 1024 };
+        struct Tile {
+            int row, rows;          // the first body, and how many
+            int column, columns;    // zero columns for a tile on the diagonal
+            int offset;             // into tileFx and tileFy
+        };
+        std::vector<Tile> tiles;
+        std::vector<double> tileFx, tileFy;
+        std::vector<int> found;     // contacts in each block of candidates
+        
+        // prevent copying or assignment
+        Universe& operator=(Universe&);
+        Universe(Universe&);
+
+    }; // end class Universe
+        
+} // end namespace PatternSpace
+#endif  // PATTERN_SPACE_UNIVERSE_INCLUSION_GUARD